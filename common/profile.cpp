@@ -0,0 +1,172 @@
+//
+// Scoped-timer profiling instrumentation shared by the labs
+//
+
+#include "profile.h"
+
+#ifdef PROFILE_ENABLED
+
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#define PROFILE_NO_NODE 0xffffffffU
+
+/// call path node, children are linked through next_sibling
+typedef struct {
+    uint32_t region;
+    uint32_t parent;
+    uint32_t first_child;
+    uint32_t next_sibling;
+    uint64_t cycles;
+    uint64_t calls;
+} profile_node_t;
+
+/// call tree of one thread, node 0 is the root
+typedef struct {
+    std::vector<profile_node_t> nodes;
+    uint32_t current;
+} profile_tree_t;
+
+static std::mutex &profile_mutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+static std::vector<const char *> &profile_region_names() {
+    static std::vector<const char *> names;
+    return names;
+}
+
+/// trees of all threads, kept alive until exit
+static std::vector<profile_tree_t *> &profile_trees() {
+    static std::vector<profile_tree_t *> trees;
+    return trees;
+}
+
+static profile_tree_t *profile_thread_tree() {
+    static thread_local profile_tree_t *tree = nullptr;
+    if (tree == nullptr) {
+        tree = new profile_tree_t();
+        tree->nodes.push_back({PROFILE_NO_NODE, PROFILE_NO_NODE, PROFILE_NO_NODE, PROFILE_NO_NODE, 0, 0});
+        tree->current = 0;
+        std::lock_guard<std::mutex> lock(profile_mutex());
+        profile_trees().push_back(tree);
+    }
+    return tree;
+}
+
+uint32_t profile_region(const char *name) {
+    std::lock_guard<std::mutex> lock(profile_mutex());
+    profile_region_names().push_back(name);
+    return (uint32_t) profile_region_names().size() - 1;
+}
+
+uint32_t profile_enter(uint32_t region) {
+    profile_tree_t *tree = profile_thread_tree();
+    uint32_t parent = tree->current;
+    uint32_t child = tree->nodes[parent].first_child;
+    while (child != PROFILE_NO_NODE && tree->nodes[child].region != region) {
+        child = tree->nodes[child].next_sibling;
+    }
+    if (child == PROFILE_NO_NODE) {
+        child = (uint32_t) tree->nodes.size();
+        tree->nodes.push_back({region, parent, PROFILE_NO_NODE, tree->nodes[parent].first_child, 0, 0});
+        tree->nodes[parent].first_child = child;
+    }
+    tree->current = child;
+    return child;
+}
+
+void profile_leave(uint32_t node, uint64_t cycles) {
+    profile_tree_t *tree = profile_thread_tree();
+    profile_node_t &entry = tree->nodes[node];
+    entry.cycles += cycles;
+    ++entry.calls;
+    tree->current = entry.parent;
+}
+
+/// region totals, recursive calls are counted once by their outermost node
+typedef struct {
+    uint64_t cycles;
+    uint64_t calls;
+} profile_total_t;
+
+static void profile_collect(const profile_tree_t *tree, uint32_t node, const std::string &path,
+                            std::vector<uint32_t> &active_regions,
+                            std::map<std::string, uint64_t> &folded, std::vector<profile_total_t> &totals) {
+    const profile_node_t &entry = tree->nodes[node];
+    const char *name = profile_region_names()[entry.region];
+    std::string node_path = path.empty() ? std::string(name) : path + ";" + name;
+    uint64_t children_cycles = 0;
+    for (uint32_t child = entry.first_child; child != PROFILE_NO_NODE; child = tree->nodes[child].next_sibling) {
+        children_cycles += tree->nodes[child].cycles;
+    }
+    folded[node_path] += entry.cycles > children_cycles ? entry.cycles - children_cycles : 0;
+    totals[entry.region].calls += entry.calls;
+    bool outermost = true;
+    for (uint32_t region : active_regions) {
+        outermost &= region != entry.region;
+    }
+    if (outermost) {
+        totals[entry.region].cycles += entry.cycles;
+    }
+    active_regions.push_back(entry.region);
+    for (uint32_t child = entry.first_child; child != PROFILE_NO_NODE; child = tree->nodes[child].next_sibling) {
+        profile_collect(tree, child, node_path, active_regions, folded, totals);
+    }
+    active_regions.pop_back();
+}
+
+void profile_dump() {
+    std::lock_guard<std::mutex> lock(profile_mutex());
+    std::map<std::string, uint64_t> folded;
+    std::vector<profile_total_t> totals(profile_region_names().size(), profile_total_t{0, 0});
+    std::vector<uint32_t> active_regions;
+    for (const profile_tree_t *tree : profile_trees()) {
+        for (uint32_t child = tree->nodes[0].first_child; child != PROFILE_NO_NODE;
+             child = tree->nodes[child].next_sibling) {
+            profile_collect(tree, child, std::string(), active_regions, folded, totals);
+        }
+    }
+    const char *out_path = getenv("PROFILE_OUT");
+    if (out_path == nullptr) {
+        out_path = "profile.folded";
+    }
+    FILE *out = fopen(out_path, "w");
+    if (out != nullptr) {
+        for (auto &entry : folded) {
+            fprintf(out, "%s %llu\n", entry.first.c_str(), (unsigned long long) entry.second);
+        }
+        fclose(out);
+    } else {
+        fprintf(stderr, "Unable to write profile to %s\n", out_path);
+    }
+    fprintf(stderr, "%-32s %16s %20s\n", "region", "calls", "cycles");
+    for (size_t region = 0; region < totals.size(); ++region) {
+        if (totals[region].calls == 0) {
+            continue;
+        }
+        fprintf(stderr, "%-32s %16llu %20llu\n", profile_region_names()[region],
+                (unsigned long long) totals[region].calls, (unsigned long long) totals[region].cycles);
+    }
+}
+
+/// dumps the profile when static objects are destroyed at exit
+static struct profile_reporter_t {
+    profile_reporter_t() {
+        // construct the registries first, so they are destroyed after the reporter
+        profile_mutex();
+        profile_region_names();
+        profile_trees();
+    }
+
+    ~profile_reporter_t() {
+        profile_dump();
+    }
+} profile_reporter;
+
+#endif //PROFILE_ENABLED
@@ -0,0 +1,79 @@
+//
+// Scoped-timer profiling instrumentation shared by the labs
+//
+// Built only with PROFILE_ENABLED defined (cmake -DENABLE_PROFILE=ON), otherwise PROFILE_SCOPE expands to nothing.
+// Timers count TSC cycles per call path; at exit the profile is written to the file named by the PROFILE_OUT
+// environment variable (profile.folded by default) as flamegraph.pl compatible folded stacks of self cycles,
+// and per-region totals are printed to stderr.
+//
+
+#ifndef CC_LABS_PROFILE_H
+#define CC_LABS_PROFILE_H
+
+#ifdef PROFILE_ENABLED
+
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <ctime>
+#endif
+
+/// returns current value of the cycle counter
+static inline uint64_t profile_cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000U + (uint64_t) now.tv_nsec;
+#endif
+}
+
+/**
+ * Registers the named region, should be called once per instrumentation point
+ * @param name Region name with static storage duration
+ * @return region id
+ */
+uint32_t profile_region(const char *name);
+
+/**
+ * Enters the region in the call tree of the calling thread
+ * @return node id to pass to profile_leave()
+ */
+uint32_t profile_enter(uint32_t region);
+
+/// leaves the node entered by profile_enter(), adding elapsed cycles to it
+void profile_leave(uint32_t node, uint64_t cycles);
+
+/// writes collected profile of all threads, called automatically at exit
+void profile_dump();
+
+/// measures the lifetime of the enclosing scope
+struct profile_scope_t {
+    uint32_t node;
+    uint64_t start;
+
+    explicit profile_scope_t(uint32_t region) : node(profile_enter(region)), start(profile_cycles()) {}
+
+    ~profile_scope_t() {
+        profile_leave(node, profile_cycles() - start);
+    }
+};
+
+#define PROFILE_CONCAT_IMPL(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_IMPL(a, b)
+
+/// times the rest of the enclosing scope as a region with given name
+#define PROFILE_SCOPE(name)                                                             \
+    static const uint32_t PROFILE_CONCAT(profile_region_, __LINE__) = profile_region(name); \
+    profile_scope_t PROFILE_CONCAT(profile_scope_, __LINE__)(PROFILE_CONCAT(profile_region_, __LINE__));
+
+#else
+
+#define PROFILE_SCOPE(name)
+
+#endif //PROFILE_ENABLED
+
+#endif //CC_LABS_PROFILE_H
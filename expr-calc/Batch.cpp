@@ -0,0 +1,138 @@
+/**
+ * Non-interactive evaluation of newline-separated expressions
+ */
+
+#include <atomic>
+#include <thread>
+#include "Batch.h"
+#include "profile.h"
+
+/**
+ * Terminates the lines of the block in place
+ * @param lines Filled with the offsets of line starts
+ */
+static void splitLines(char *block, Size size, std::vector<Size> &lines) {
+    lines.clear();
+    Size start = 0;
+    while (start < size) {
+        auto newline = static_cast<char *>(std::memchr(block + start, '\n', size - start));
+        Size end = newline == nullptr ? size : static_cast<Size>(newline - block);
+        Size trimmed = end;
+        while (trimmed > start && block[trimmed - 1] == '\r') {
+            --trimmed;
+        }
+        block[trimmed] = '\0';
+        lines.push_back(start);
+        start = end + 1;
+    }
+}
+
+template<typename V>
+static void evaluateLines(std::vector<BasicEvaluator<V>> &evaluators, const char *block,
+                          const std::vector<Size> &lines, std::vector<V> &values, std::vector<uint8_t> &succeeded) {
+    PROFILE_SCOPE("evaluateLines")
+    values.resize(lines.size());
+    succeeded.resize(lines.size());
+    std::atomic<Size> nextLine(0);
+    auto worker = [&](BasicEvaluator<V> &evaluator) {
+        Size first;
+        while ((first = nextLine.fetch_add(batchChunkSize)) < lines.size()) {
+            Size last = std::min(first + batchChunkSize, lines.size());
+            for (Size i = first; i < last; ++i) {
+                succeeded[i] = evaluator.evaluate(block + lines[i], values[i]) ? 1 : 0;
+            }
+        }
+    };
+    if (evaluators.size() == 1) {
+        worker(evaluators[0]);
+        return;
+    }
+    std::vector<std::thread> threads;
+    for (auto &evaluator : evaluators) {
+        threads.emplace_back(worker, std::ref(evaluator));
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+}
+
+template<typename V>
+static void writeResults(FILE *out, const std::vector<V> &values, const std::vector<uint8_t> &succeeded,
+                         std::vector<char> &text) {
+    PROFILE_SCOPE("writeResults")
+    // longest line is the longest value and a newline, "error" is shorter
+    text.resize(values.size() * (ValueTraits<V>::formatLength + 1));
+    char *ptr = text.data();
+    for (Size i = 0; i < values.size(); ++i) {
+        if (succeeded[i]) {
+            ptr = ValueTraits<V>::format(ptr, values[i]);
+        } else {
+            std::memcpy(ptr, "error", 5);
+            ptr += 5;
+        }
+        *ptr++ = '\n';
+    }
+    std::fwrite(text.data(), 1, static_cast<Size>(ptr - text.data()), out);
+}
+
+template<typename V>
+CacheStats evaluateBatch(FILE *in, FILE *out, const BatchConfig &config) {
+    Size threadCount = config.threadCount > 0 ?
+                       static_cast<Size>(config.threadCount) : std::max(1U, std::thread::hardware_concurrency());
+    std::vector<BasicEvaluator<V>> evaluators;
+    evaluators.reserve(threadCount);
+    for (Size t = 0; t < threadCount; ++t) {
+        evaluators.emplace_back(config.cacheLimit / threadCount);
+    }
+
+    // one spare byte terminates the last line of the input, if it has no newline
+    std::vector<char> block(batchBlockSize + 1);
+    std::vector<Size> lines;
+    std::vector<V> values;
+    std::vector<uint8_t> succeeded;
+    std::vector<char> text;
+    Size filled = 0;
+    bool eof = false;
+    while (!eof || filled > 0) {
+        if (!eof) {
+            if (filled + 1 == block.size()) {
+                block.resize(block.size() * 2);
+            }
+            Size read = std::fread(block.data() + filled, 1, block.size() - 1 - filled, in);
+            filled += read;
+            eof = read == 0;
+        }
+        // only complete lines are evaluated until the end of the input
+        Size end = filled;
+        if (!eof) {
+            auto newline = static_cast<char *>(memrchr(block.data(), '\n', filled));
+            if (newline == nullptr) {
+                continue;
+            }
+            end = static_cast<Size>(newline - block.data()) + 1;
+        }
+        splitLines(block.data(), end, lines);
+        evaluateLines(evaluators, block.data(), lines, values, succeeded);
+        writeResults(out, values, succeeded, text);
+        std::memmove(block.data(), block.data() + end, filled - end);
+        filled -= end;
+    }
+    std::fflush(out);
+
+    CacheStats total{};
+    for (auto &evaluator : evaluators) {
+        const CacheStats &stats = evaluator.cacheStats();
+        total.hits += stats.hits;
+        total.misses += stats.misses;
+        total.insertions += stats.insertions;
+        total.evictions += stats.evictions;
+        total.entries += stats.entries;
+        total.memory += stats.memory;
+    }
+    return total;
+}
+
+#define INSTANTIATE_EVALUATE_BATCH(V) \
+    template CacheStats evaluateBatch<V>(FILE *in, FILE *out, const BatchConfig &config);
+
+FOR_EACH_VALUE_TYPE(INSTANTIATE_EVALUATE_BATCH)
@@ -0,0 +1,35 @@
+/**
+ * Non-interactive evaluation of newline-separated expressions
+ */
+
+#ifndef CC_LABS_BATCH_H
+#define CC_LABS_BATCH_H
+
+#include <cstdio>
+#include "Evaluator.h"
+
+/// bytes of input evaluated in parallel at once, longer lines grow the block
+const Size batchBlockSize = 16U << 20U;
+
+/// lines taken by a worker at once
+const Size batchChunkSize = 1024;
+
+struct BatchConfig {
+    /// count of worker threads, 0 to use all cores
+    int threadCount;
+    /// memory limit of all result caches, split evenly between the workers
+    Size cacheLimit;
+};
+
+/**
+ * Evaluates every line of the input and writes one result per line in input order,
+ * "error" for expressions which cannot be evaluated
+ * The input is read in blocks, lines of a block are spread across the worker threads,
+ * each worker keeps its own evaluator and cache between blocks
+ * V is the numeric type the expressions are evaluated in, one of FOR_EACH_VALUE_TYPE
+ * @return summed stats of the workers' caches
+ */
+template<typename V>
+CacheStats evaluateBatch(FILE *in, FILE *out, const BatchConfig &config);
+
+#endif //CC_LABS_BATCH_H
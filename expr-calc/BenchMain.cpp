@@ -0,0 +1,187 @@
+/**
+ * expr_calc_bench: throughput of the lexer, parser, calculator, compiler and virtual machine
+ * on generated expressions, reported as JSON
+ */
+
+#include <chrono>
+#include <new>
+#include "Bytecode.h"
+#include "Generator.h"
+
+/// heap allocations of the process, counted by the replaced operator new
+static uint64_t allocationCount = 0;
+
+/// receives the sums of the phases, so their work is not optimized out
+static volatile uint64_t benchSink = 0;
+
+void *operator new(std::size_t size) {
+    ++allocationCount;
+    void *ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+struct PhaseStats {
+    const char *name;
+    /// time of the fastest pass
+    double seconds;
+    /// allocations of the last pass, buffers reused between expressions have grown by then
+    uint64_t allocations;
+};
+
+template<typename Run>
+static PhaseStats measure(const char *name, int repeat, Run &&run) {
+    PhaseStats stats{name, 0, 0};
+    for (int pass = 0; pass < repeat; ++pass) {
+        uint64_t allocations = allocationCount;
+        auto start = std::chrono::steady_clock::now();
+        run();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (pass == 0 || elapsed.count() < stats.seconds) {
+            stats.seconds = elapsed.count();
+        }
+        stats.allocations = allocationCount - allocations;
+    }
+    return stats;
+}
+
+static void printUsage() {
+    std::printf("Usage:\n"
+                "\texpr_calc_bench [--count <expressions>] [--operands <per expression>] [--depth <nesting>]\n"
+                "\t                [--operators <symbols of \"<>=+-*/\">] [--seed <seed>] [--repeat <passes>]\n");
+}
+
+int main(int argc, const char **argv) {
+    GeneratorConfig config{16, 4, "<>=+-*/", 1};
+    Size count = 100000;
+    int repeat = 5;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--count") == 0 && i + 1 < argc) {
+            count = static_cast<Size>(std::atoll(argv[++i]));
+        } else if (std::strcmp(argv[i], "--operands") == 0 && i + 1 < argc) {
+            config.operands = static_cast<Size>(std::atoll(argv[++i]));
+        } else if (std::strcmp(argv[i], "--depth") == 0 && i + 1 < argc) {
+            config.depth = static_cast<Size>(std::atoll(argv[++i]));
+        } else if (std::strcmp(argv[i], "--operators") == 0 && i + 1 < argc) {
+            config.operators = argv[++i];
+        } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            config.seed = static_cast<uint64_t>(std::atoll(argv[++i]));
+        } else if (std::strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = std::atoi(argv[++i]);
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (count == 0 || config.operands == 0 || repeat <= 0 || config.operators.empty() ||
+        config.operators.find_first_not_of("<>=+-*/") != std::string::npos) {
+        printUsage();
+        return 1;
+    }
+
+    std::vector<std::string> expressions(count);
+    ExpressionGenerator generator(config);
+    for (auto &expression : expressions) {
+        generator.generate(expression);
+    }
+
+    // the trees and programs of all expressions are kept, so the later phases run without parsing
+    Size tokens = 0;
+    NodeArena trees;
+    std::vector<NodeIndex> roots;
+    roots.reserve(count);
+    for (auto &expression : expressions) {
+        Lexer lexer(expression.c_str());
+        while (!lexer.atEnd()) {
+            lexer.nextToken();
+            ++tokens;
+        }
+        Lexer parserLexer(expression.c_str());
+        roots.push_back(Parser(parserLexer, trees).parse());
+    }
+    Size nodes = trees.size();
+    std::vector<Program> programs(count);
+    for (Size i = 0; i < count; ++i) {
+        Compiler::compile(trees, roots[i], programs[i]);
+    }
+
+    uint64_t sink = 0;
+    int64_t calculated = 0;
+    int64_t executed = 0;
+    NodeArena arena;
+    Program program;
+    VirtualMachine vm;
+    PhaseStats phases[] = {
+            measure("lex", repeat, [&]() {
+                for (auto &expression : expressions) {
+                    Lexer lexer(expression.c_str());
+                    while (!lexer.atEnd()) {
+                        sink += lexer.nextToken().type;
+                    }
+                }
+            }),
+            // lexing is included, the parser pulls the tokens
+            measure("parse", repeat, [&]() {
+                for (auto &expression : expressions) {
+                    Lexer lexer(expression.c_str());
+                    sink += Parser(lexer, arena).parse();
+                    arena.reset();
+                }
+            }),
+            measure("calculate", repeat, [&]() {
+                calculated = 0;
+                for (NodeIndex root : roots) {
+                    Value value = 0;
+                    Calculator::calculate(trees, root, value);
+                    calculated += value;
+                }
+            }),
+            measure("compile", repeat, [&]() {
+                for (NodeIndex root : roots) {
+                    Compiler::compile(trees, root, program);
+                    sink += program.code.size();
+                }
+            }),
+            measure("run", repeat, [&]() {
+                executed = 0;
+                for (auto &compiled : programs) {
+                    Value value = 0;
+                    vm.run(compiled, value);
+                    executed += value;
+                }
+            }),
+    };
+    benchSink = sink;
+    if (calculated != executed) {
+        std::fprintf(stderr, "bench error : calculator and virtual machine disagree, %lld and %lld\n",
+                     (long long) calculated, (long long) executed);
+        return 1;
+    }
+
+    std::printf("{\n  \"config\": {\"count\": %zu, \"operands\": %zu, \"depth\": %zu, \"operators\": \"%s\", "
+                "\"seed\": %llu, \"repeat\": %d},\n",
+                count, config.operands, config.depth, config.operators.c_str(),
+                (unsigned long long) config.seed, repeat);
+    std::printf("  \"tokens_per_expr\": %.2f,\n  \"nodes_per_expr\": %.2f,\n  \"checksum\": %lld,\n  \"phases\": {",
+                (double) tokens / count, (double) nodes / count, (long long) calculated);
+    const char *separator = "\n";
+    for (const PhaseStats &phase : phases) {
+        std::printf("%s    \"%s\": {\"ns_per_expr\": %.1f, \"tokens_per_s\": %.0f, \"nodes_per_s\": %.0f, "
+                    "\"allocations_per_expr\": %.3f}",
+                    separator, phase.name, phase.seconds * 1e9 / count, tokens / phase.seconds,
+                    nodes / phase.seconds, (double) phase.allocations / count);
+        separator = ",\n";
+    }
+    std::printf("\n  }\n}\n");
+    return 0;
+}
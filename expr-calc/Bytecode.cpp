@@ -0,0 +1,162 @@
+/**
+ * Postfix bytecode of expressions and the stack machine which runs it
+ */
+
+#include "Bytecode.h"
+#include "profile.h"
+#include "Trace.h"
+
+const char *OpCodeToString(OpCode code) {
+    switch (code) {
+        case OP_PUSH: return "PUSH";
+        case OP_LOAD: return "LOAD";
+        case OP_GREATER_THAN: return "GREATER_THAN";
+        case OP_LESS_THAN: return "LESS_THAN";
+        case OP_EQUAL_TO: return "EQUAL_TO";
+        case OP_ADDITION: return "ADDITION";
+        case OP_SUBTRACTION: return "SUBTRACTION";
+        case OP_MULTIPLICATION: return "MULTIPLICATION";
+        case OP_DIVISION: return "DIVISION";
+        default: return "UNKNOWN";
+    }
+}
+
+template<typename V>
+OpCode BasicCompiler<V>::operatorToOpCode(Operator oper) {
+    switch (oper) {
+        case Operator::GREATER_THAN: return OP_GREATER_THAN;
+        case Operator::LESS_THAN: return OP_LESS_THAN;
+        case Operator::EQUAL_TO: return OP_EQUAL_TO;
+        case Operator::ADDITION: return OP_ADDITION;
+        case Operator::SUBTRACTION: return OP_SUBTRACTION;
+        case Operator::MULTIPLICATION: return OP_MULTIPLICATION;
+        case Operator::DIVISION: return OP_DIVISION;
+        default: {
+            std::fprintf(stderr, "compilation error : unexpected operator %s, program logic error\n",
+                         OperatorToString(oper));
+            std::exit(-1);
+        }
+    }
+}
+
+template<typename V>
+void BasicCompiler<V>::emit(BasicProgram<V> &program, Size &depth, BasicInstruction<V> instruction) {
+    program.code.push_back(instruction);
+    // push and load add a value, operators replace two values by one
+    if (instruction.code == OP_PUSH || instruction.code == OP_LOAD) {
+        program.maxStack = std::max(program.maxStack, ++depth);
+    } else {
+        --depth;
+    }
+}
+
+template<typename V>
+void BasicCompiler<V>::compile(const BasicNodeArena<V> &arena, NodeIndex root, BasicProgram<V> &program) {
+    PROFILE_SCOPE("Compiler::compile")
+    // steps of the walk, reused by the compilations of the thread
+    static thread_local std::vector<WalkStep> steps;
+    program.clear();
+    Size depth = 0;
+    walkPostfix(arena, root, steps, [&](const BasicNode<V> &node) {
+        if (node.type == ExpressionType::INTEGER) {
+            emit(program, depth, BasicInstruction<V>::makePush(node.value));
+        } else {
+            emit(program, depth, BasicInstruction<V>::makeLoad(node.operand));
+        }
+    }, [&](Operator oper) {
+        emit(program, depth, BasicInstruction<V>::makeOperator(operatorToOpCode(oper)));
+    });
+}
+
+template<typename V>
+bool BasicVirtualMachine<V>::run(const BasicProgram<V> &program, V &result, const V *variables) {
+    PROFILE_SCOPE("VirtualMachine::run")
+    if (stack.size() < program.maxStack) {
+        stack.resize(program.maxStack);
+    }
+    V *base = stack.data();
+    // points past the topmost value
+    V *top = base;
+    const BasicInstruction<V> *end = program.code.data() + program.code.size();
+    for (const BasicInstruction<V> *ip = program.code.data(); ip != end; ++ip) {
+        if (ip->code == OP_PUSH) {
+            // a literal of a checked type may be out of its range
+            if (!ValueTraits<V>::isValid(ip->value)) {
+                BasicVirtualMachine::reportError("VALUE overflows");
+                return false;
+            }
+            *top++ = ip->value;
+            continue;
+        }
+        if (ip->code == OP_LOAD) {
+            if (variables == nullptr) {
+                BasicVirtualMachine::reportError("VARIABLE has no value");
+                return false;
+            }
+            *top++ = variables[ip->variable];
+            continue;
+        }
+        V left = top[-2];
+        V right = top[-1];
+        V value;
+        TRACE_START(start);
+        switch (ip->code) {
+            case OP_GREATER_THAN: {
+                value = left > right ? V(1) : V(0);
+                break;
+            }
+            case OP_LESS_THAN: {
+                value = left < right ? V(1) : V(0);
+                break;
+            }
+            case OP_EQUAL_TO: {
+                value = left == right ? V(1) : V(0);
+                break;
+            }
+            case OP_ADDITION: {
+                value = left + right;
+                break;
+            }
+            case OP_SUBTRACTION: {
+                value = left - right;
+                break;
+            }
+            case OP_MULTIPLICATION: {
+                value = left * right;
+                break;
+            }
+            case OP_DIVISION: {
+                if (right == 0) {
+                    TRACE_DIVISION_BY_ZERO(left, 1);
+                    BasicVirtualMachine::reportError("VALUE should not be divided by zero");
+                    return false;
+                }
+                value = ValueTraits<V>::divide(left, right);
+                break;
+            }
+            default: {
+                BasicVirtualMachine::reportError("unknown instruction");
+                return false;
+            }
+        }
+        TRACE_APPLY(opCodeToOperator(ip->code), left, right, value, start);
+        if (!ValueTraits<V>::isValid(value)) {
+            BasicVirtualMachine::reportError("VALUE overflows");
+            return false;
+        }
+        top[-2] = value;
+        --top;
+    }
+    if (top != base + 1) {
+        BasicVirtualMachine::reportError("program should leave exactly one value on the stack");
+        return false;
+    }
+    result = base[0];
+    return true;
+}
+
+#define INSTANTIATE_BYTECODE_TEMPLATES(V) \
+    template class BasicCompiler<V>; \
+    template class BasicVirtualMachine<V>;
+
+FOR_EACH_VALUE_TYPE(INSTANTIATE_BYTECODE_TEMPLATES)
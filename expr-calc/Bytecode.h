@@ -0,0 +1,133 @@
+/**
+ * Postfix bytecode of expressions and the stack machine which runs it
+ */
+
+#ifndef CC_LABS_BYTECODE_H
+#define CC_LABS_BYTECODE_H
+
+#include <cstdint>
+#include <vector>
+#include "Calculator.h"
+
+enum OpCode : uint8_t {
+    OP_PUSH = 0,
+    OP_LOAD,
+    OP_GREATER_THAN,
+    OP_LESS_THAN,
+    OP_EQUAL_TO,
+    OP_ADDITION,
+    OP_SUBTRACTION,
+    OP_MULTIPLICATION,
+    OP_DIVISION,
+};
+
+const char *OpCodeToString(OpCode code);
+
+static_assert(OP_DIVISION - OP_GREATER_THAN == DIVISION - GREATER_THAN, "operator opcodes follow Operator order");
+
+/// @return operator of an operator opcode
+static inline Operator opCodeToOperator(OpCode code) {
+    return static_cast<Operator>(code - OP_GREATER_THAN + GREATER_THAN);
+}
+
+template<typename V>
+struct BasicInstruction {
+    OpCode code;
+    union {
+        /// constant of OP_PUSH
+        V value;
+        /// variable index of OP_LOAD
+        uint32_t variable;
+    };
+
+    static BasicInstruction makePush(V value) {
+        BasicInstruction instruction{OP_PUSH, {}};
+        instruction.value = value;
+        return instruction;
+    }
+
+    static BasicInstruction makeLoad(uint32_t variable) {
+        BasicInstruction instruction{OP_LOAD, {}};
+        instruction.variable = variable;
+        return instruction;
+    }
+
+    static BasicInstruction makeOperator(OpCode code) {
+        return BasicInstruction{code, {}};
+    }
+};
+
+typedef BasicInstruction<Value> Instruction;
+
+/**
+ * Compiled expression, operators follow their operands
+ * The program does not refer to the arena it was compiled from, so it can be run any number of times
+ */
+template<typename V>
+struct BasicProgram {
+    std::vector<BasicInstruction<V>> code;
+    /// stack depth needed to run the program
+    Size maxStack = 0;
+
+    void clear() {
+        code.clear();
+        maxStack = 0;
+    }
+};
+
+typedef BasicProgram<Value> Program;
+
+template<typename V>
+class BasicCompiler {
+
+public:
+    /**
+     * Lowers the parsed expression into postfix bytecode
+     * @param root Index returned by Parser::parse()
+     * @param program Program to fill, its previous code is dropped
+     */
+    static void compile(const BasicNodeArena<V> &arena, NodeIndex root, BasicProgram<V> &program);
+
+private:
+
+    static void emit(BasicProgram<V> &program, Size &depth, BasicInstruction<V> instruction);
+
+    static OpCode operatorToOpCode(Operator oper);
+
+};
+
+typedef BasicCompiler<Value> Compiler;
+
+template<typename V>
+class BasicVirtualMachine {
+private:
+    std::vector<V> stack;
+
+public:
+    BasicVirtualMachine() = default;
+
+    /**
+     * Runs the program, the stack is reused between runs
+     * @param result Value of the expression, untouched on error
+     * @param variables Values of the variables by their index, nullptr if the program has none
+     * @return false on division by zero, overflow of a checked type, a missing variable or a malformed program
+     */
+    bool run(const BasicProgram<V> &program, V &result, const V *variables = nullptr);
+
+private:
+
+    static inline void reportError(const char *msg) {
+        std::fprintf(stderr, "execution error : %s\n", msg);
+    }
+
+};
+
+typedef BasicVirtualMachine<Value> VirtualMachine;
+
+#define EXTERN_BYTECODE_TEMPLATES(V) \
+    extern template class BasicCompiler<V>; \
+    extern template class BasicVirtualMachine<V>;
+
+FOR_EACH_VALUE_TYPE(EXTERN_BYTECODE_TEMPLATES)
+
+#endif //CC_LABS_BYTECODE_H
@@ -3,12 +3,15 @@
  */
 
 #include "Calculator.h"
+#include "profile.h"
+#include "Trace.h"
 
 const char *TokenTypeToString(TokenType type) {
     switch (type) {
         case OPERATOR: return "OPERATOR";
         case DELIMITER: return "DELIMITER";
         case VALUE: return "VALUE";
+        case IDENTIFIER: return "IDENTIFIER";
         default: return "TYPE_UNKNOWN";
     }
 }
@@ -26,7 +29,8 @@ const char *OperatorToString(Operator oper) {
     }
 }
 
-Symbol Lexer::nextSymbol() {
+template<typename V>
+Symbol BasicLexer<V>::nextSymbol() {
     if (source != nullptr) {
         if (source[readBufferPtr] == '\0') {
             return '\0';
@@ -34,212 +38,266 @@ Symbol Lexer::nextSymbol() {
             return source[readBufferPtr];
         }
     }
+    Symbol *buffer = streamBuffer != nullptr ? streamBuffer : readBuffer;
     if (readBufferPtr >= readBufferSize) {
-        readBufferSize = std::fread(readBuffer, 1, readBufferCap, stdin);
+        readBufferSize = std::fread(buffer, 1, streamBuffer != nullptr ? streamBufferCap : readBufferCap,
+                                    input != nullptr ? input : stdin);
+        readBufferPtr = 0;
         if (readBufferSize == 0) {
             return '\0';
         }
-        readBufferPtr = 0;
     }
-    return readBuffer[readBufferPtr];
+    return buffer[readBufferPtr];
 }
 
-Token Lexer::nextToken() {
+template<typename V>
+BasicToken<V> BasicLexer<V>::nextToken() {
+    PROFILE_SCOPE("Lexer::nextToken")
     Symbol s1 = nextSymbol();
+    // spaces are not stated in the grammar, they are skipped
+    while (s1 == ' ') {
+        if (traceSpaces) {
+            TRACE_SPACE();
+        }
+        ++readBufferPtr;
+        s1 = nextSymbol();
+    }
     readBufferPtr++;
     switch (s1) {
-        case '>': return Token::makeOperatorToken(Operator::GREATER_THAN);
-        case '<': return Token::makeOperatorToken(Operator::LESS_THAN);
-        case '=': return Token::makeOperatorToken(Operator::EQUAL_TO);
-        case '+': return Token::makeOperatorToken(Operator::ADDITION);
-        case '-': return Token::makeOperatorToken(Operator::SUBTRACTION);
-        case '*': return Token::makeOperatorToken(Operator::MULTIPLICATION);
-        case '/': return Token::makeOperatorToken(Operator::DIVISION);
-        case '(': return Token::makeDelimiterToken(Delimiter::PAREN_OPEN);
-        case ')': return Token::makeDelimiterToken(Delimiter::PAREN_CLOSE);
+        case '>': return BasicToken<V>::makeOperatorToken(Operator::GREATER_THAN);
+        case '<': return BasicToken<V>::makeOperatorToken(Operator::LESS_THAN);
+        case '=': return BasicToken<V>::makeOperatorToken(Operator::EQUAL_TO);
+        case '+': return BasicToken<V>::makeOperatorToken(Operator::ADDITION);
+        case '-': return BasicToken<V>::makeOperatorToken(Operator::SUBTRACTION);
+        case '*': return BasicToken<V>::makeOperatorToken(Operator::MULTIPLICATION);
+        case '/': return BasicToken<V>::makeOperatorToken(Operator::DIVISION);
+        case '(': return BasicToken<V>::makeDelimiterToken(Delimiter::PAREN_OPEN);
+        case ')': return BasicToken<V>::makeDelimiterToken(Delimiter::PAREN_CLOSE);
         default: {
             --readBufferPtr;
-            while (s1 == ' ') {
-                std::fprintf(stderr, "WARN: spaces are not stated in the grammar, skipping them by default\n");
+            if (isLetter(s1)) {
+                while (isLetter(s1) || isDigit(s1)) {
+                    stashSymbol(s1);
+                    ++readBufferPtr;
+                    s1 = nextSymbol();
+                }
+                BasicToken<V> token;
+                if (variables != nullptr) {
+                    token = BasicToken<V>::makeVariableToken(variables->intern(stashBuffer, stashBufferPtr));
+                }
+                std::memset(stashBuffer, 0, stashBufferPtr);
+                stashBufferPtr = 0;
+                return token;
+            }
+            if (!isDigit(s1) && s1 != '\0') {
+                // unknown symbol
                 ++readBufferPtr;
-                s1 = nextSymbol();
+                return BasicToken<V>();
             }
             while (isDigit(s1)) {
                 stashSymbol(s1);
                 ++readBufferPtr;
                 s1 = nextSymbol();
             }
-            char *endPtr = nullptr;
-            long value = strtol(stashBuffer, &endPtr, 10);
+            V value = ValueTraits<V>::parse(stashBuffer);
             std::memset(stashBuffer, 0, stashBufferPtr);
             stashBufferPtr = 0;
-            return Token::makeValueToken(static_cast<Value>(value));
+            return BasicToken<V>::makeValueToken(value);
         }
     }
 }
 
-Expression *Parser::parseExpression() {
-    return parseRelation();
+/// frames of the expressions being parsed, reused by the parsers of the thread
+static std::vector<ParseFrame> &parseFrames() {
+    static thread_local std::vector<ParseFrame> frames;
+    return frames;
 }
 
-Relation *Parser::parseRelation() {
-    Term *left = parseTerm();
-    if (peekToken().type == OPERATOR) {
-        Operator oper = peekToken().oper;
-        if (oper != Operator::EQUAL_TO &&
-            oper != Operator::LESS_THAN &&
-            oper != Operator::GREATER_THAN) {
-            return new Relation(left);
-        }
-        commitToken();
-        Term *right = parseTerm();
-        return new Relation(left, oper, right);
-    } else {
-        return new Relation(left);
+template<typename V>
+int BasicParser<V>::bindingPower(const BasicToken<V> &token) {
+    if (token.type != OPERATOR) {
+        return 0;
+    }
+    switch (token.oper) {
+        case Operator::GREATER_THAN:
+        case Operator::LESS_THAN:
+        case Operator::EQUAL_TO: return relationPower;
+        case Operator::ADDITION:
+        case Operator::SUBTRACTION: return termPower;
+        case Operator::MULTIPLICATION:
+        case Operator::DIVISION: return factorPower;
+        default: return 0;
     }
 }
 
-Term *Parser::parseTerm() {
-    Factor *left = parseFactor();
-    auto first = new Term(left);
-    auto last = first;
-
-    while (peekToken().type == OPERATOR) {
-        Operator oper = peekToken().oper;
-        if (oper != Operator::ADDITION &&
-            oper != Operator::SUBTRACTION) {
-            return first;
-        }
-        commitToken();
-        Factor *right = parseFactor();
-        last = new Term(right, oper, last);
-    }
-    return first;
+template<typename V>
+ParseFrame BasicParser<V>::openSide(NodeIndex relation, NodeIndex term) {
+    NodeIndex factor = arena.add(FACTOR, OPER_UNKNOWN, NO_NODE);
+    arena[term].operand = factor;
+    return ParseFrame{relation, term, factor};
 }
 
-Factor *Parser::parseFactor() {
-    Primary *left = parsePrimary();
-    auto first = new Factor(left);
-    auto last = first;
+template<typename V>
+NodeIndex BasicParser<V>::parseExpression() {
+    PROFILE_SCOPE("Parser::parseExpression")
+    std::vector<ParseFrame> &frames = parseFrames();
+    frames.clear();
+    NodeIndex root = arena.add(RELATION, OPER_UNKNOWN, NO_NODE);
+    NodeIndex rootTerm = arena.add(TERM, OPER_UNKNOWN, NO_NODE);
+    arena[root].operand = rootTerm;
+    frames.push_back(openSide(root, rootTerm));
+    while (true) {
+        // a primary is expected, it is the operand of the last FACTOR link
+        if (peekToken().type == DELIMITER && peekToken().delim == Delimiter::PAREN_OPEN) {
+            commitToken();
+            NodeIndex relation = arena.add(RELATION, OPER_UNKNOWN, NO_NODE);
+            arena[frames.back().factor].operand = arena.add(PRIMARY, OPER_UNKNOWN, relation);
+            NodeIndex term = arena.add(TERM, OPER_UNKNOWN, NO_NODE);
+            arena[relation].operand = term;
+            frames.push_back(openSide(relation, term));
+            continue;
+        }
+        arena[frames.back().factor].operand = parsePrimary();
 
-    while (peekToken().type == OPERATOR) {
-        Operator oper = peekToken().oper;
-        if (oper != Operator::MULTIPLICATION &&
-            oper != Operator::DIVISION) {
-            return first;
+        // an operator extends the chain of its power, weaker tokens complete the innermost expression
+        while (true) {
+            ParseFrame &frame = frames.back();
+            int power = bindingPower(peekToken());
+            Operator oper = peekToken().oper;
+            if (power == factorPower) {
+                commitToken();
+                NodeIndex link = arena.add(FACTOR, oper, NO_NODE);
+                arena[frame.factor].next = link;
+                frame.factor = link;
+                break;
+            }
+            if (power == termPower) {
+                commitToken();
+                NodeIndex link = arena.add(TERM, oper, NO_NODE);
+                arena[frame.term].next = link;
+                frame = openSide(frame.relation, link);
+                break;
+            }
+            // a relation has one comparison, the second one completes it
+            if (power == relationPower && arena[frame.relation].next == NO_NODE) {
+                commitToken();
+                NodeIndex term = arena.add(TERM, OPER_UNKNOWN, NO_NODE);
+                arena[frame.relation].oper = oper;
+                arena[frame.relation].next = term;
+                frame = openSide(frame.relation, term);
+                break;
+            }
+            if (frames.size() == 1) {
+                return root;
+            }
+            frames.pop_back();
+            // the token after a nested expression is taken for the closing parenthesis
+            commitToken();
         }
-        commitToken();
-        Primary *right = parsePrimary();
-        last = new Factor(right, oper, last);
     }
-    return first;
 }
 
-Primary *Parser::parsePrimary() {
-    if (peekToken().type == DELIMITER && peekToken().delim == Delimiter::PAREN_OPEN) {
-        commitToken();
-        Expression *expr = parseExpression();
-        commitToken();
-        return new Primary(expr);
+template<typename V>
+NodeIndex BasicParser<V>::parsePrimary() {
+    PROFILE_SCOPE("Parser::parsePrimary")
+    if (peekToken().type == IDENTIFIER) {
+        NodeIndex variable = parseVariable();
+        return arena.add(PRIMARY, OPER_UNKNOWN, variable);
     } else {
-        Integer *integer = parseInteger();
-        return new Primary(integer);
+        NodeIndex integer = parseInteger();
+        return arena.add(PRIMARY, OPER_UNKNOWN, integer);
     }
 }
 
-Integer *Parser::parseInteger() {
+template<typename V>
+NodeIndex BasicParser<V>::parseInteger() {
+    PROFILE_SCOPE("Parser::parseInteger")
     if (peekToken().type != VALUE) {
         char *buffer = new char[256];
         sprintf(buffer, "expected VALUE type, got %s", TokenTypeToString(peekToken().type));
-        Parser::reportError(buffer);
+        BasicParser::reportError(buffer);
         delete[] buffer;
+        failed = true;
+        // the payload of a misplaced token is not a value
+        commitToken();
+        return arena.addInteger(V(0));
     }
-    Value value = peekToken().value;
+    V value = peekToken().value;
     commitToken();
-    return new Integer(value);
+    return arena.addInteger(value);
 }
 
-Value Calculator::applyOperator(Value v1, Operator oper, Value v2) {
-    printf(" applying %s on %d, %d\n", OperatorToString(oper), v1, v2);
-    switch (oper) {
-        case Operator::GREATER_THAN: {
-            return v1 > v2 ? 1 : 0;
-        }
-        case Operator::LESS_THAN: {
-            return v1 < v2 ? 1 : 0;
-        }
-        case Operator::EQUAL_TO: {
-            return v1 == v2 ? 1 : 0;
-        }
-        case Operator::ADDITION: {
-            return v1 + v2;
-        }
-        case Operator::SUBTRACTION: {
-            return v1 - v2;
-        }
-        case Operator::MULTIPLICATION: {
-            return v1 * v2;
-        }
-        case Operator::DIVISION: {
-            if (v2 == 0) {
-                Calculator::reportError("VALUE should not be divided by zero");
-            }
-            return v1 / v2;
-        }
-        default : return -1;
+template<typename V>
+NodeIndex BasicParser<V>::parseVariable() {
+    PROFILE_SCOPE("Parser::parseVariable")
+    uint32_t variable = peekToken().variable;
+    commitToken();
+    return arena.add(VARIABLE, OPER_UNKNOWN, variable);
+}
+
+template<typename V>
+bool BasicCalculator<V>::applyOperator(V v1, Operator oper, V v2, V &result) {
+    TRACE_START(start);
+    if (oper == Operator::DIVISION && v2 == 0) {
+        TRACE_DIVISION_BY_ZERO(v1, 1);
+        BasicCalculator::reportError("VALUE should not be divided by zero");
+        return false;
+    }
+    result = applyOperation(v1, oper, v2);
+    TRACE_APPLY(oper, v1, v2, result, start);
+    if (!ValueTraits<V>::isValid(result)) {
+        BasicCalculator::reportError("VALUE overflows");
+        return false;
     }
+    return true;
 }
 
 
-Value Calculator::calculate(Expression *expression) {
-    if (expression == nullptr) {
-        Calculator::reportError("Unable to calculate nullptr Expression, program logic error");
+template<typename V>
+bool BasicCalculator<V>::calculate(const BasicNodeArena<V> &arena, NodeIndex index, V &result, const V *variables) {
+    PROFILE_SCOPE("Calculator::calculate")
+    if (index == NO_NODE || index >= arena.size()) {
+        BasicCalculator::reportError("Unable to calculate missing node, program logic error");
         std::exit(-1);
     }
-    switch (expression->type) {
-        case ExpressionType::EXPRESSION:
-        case ExpressionType::RELATION: {
-            auto relation = reinterpret_cast<Relation *>(expression);
-            Value lValue = calculate(relation->left);
-            if (relation->right) {
-                Value rValue = calculate(relation->right);
-                return applyOperator(lValue, relation->oper, rValue);
-            } else {
-                return lValue;
-            }
-        }
-        case ExpressionType::TERM: {
-            auto term = reinterpret_cast<Term *> (expression);
-            Value lValue = calculate(term->operand);
-            while (term->next) {
-                term = term->next;
-                Value rValue = calculate(term->operand);
-                lValue = applyOperator(lValue, term->oper, rValue);
+    // stacks of the walk and of the operand values, reused by the calculations of the thread
+    static thread_local std::vector<WalkStep> steps;
+    static thread_local std::vector<V> values;
+    values.clear();
+    // the walk cannot be stopped, after an error it only keeps the stack of values balanced
+    bool success = true;
+    walkPostfix(arena, index, steps, [&](const BasicNode<V> &node) {
+        if (node.type == ExpressionType::INTEGER) {
+            // a literal of a checked type may be out of its range
+            if (success && !ValueTraits<V>::isValid(node.value)) {
+                BasicCalculator::reportError("VALUE overflows");
+                success = false;
             }
-            return lValue;
-        }
-        case ExpressionType::FACTOR: {
-            auto factor = reinterpret_cast<Factor *> (expression);
-            Value lValue = calculate(factor->operand);
-            while (factor->next) {
-                factor = factor->next;
-                Value rValue = calculate(factor->operand);
-                lValue = applyOperator(lValue, factor->oper, rValue);
+            values.push_back(node.value);
+        } else if (variables == nullptr) {
+            if (success) {
+                BasicCalculator::reportError("VARIABLE has no value");
             }
-            return lValue;
-        }
-        case ExpressionType::PRIMARY: {
-            auto primary = reinterpret_cast<Primary *> (expression);
-            if (primary->integer) {
-                return calculate(primary->integer);
-            } else {
-                return calculate(primary->expression);
-            }
-        }
-        case ExpressionType::INTEGER : {
-            auto integer = reinterpret_cast<Integer *>(expression);
-            return integer->value;
+            success = false;
+            values.push_back(V(0));
+        } else {
+            values.push_back(variables[node.operand]);
         }
+    }, [&](Operator oper) {
+        V rValue = values.back();
+        values.pop_back();
+        success = success && applyOperator(values.back(), oper, rValue, values.back());
+    });
+    if (!success) {
+        return false;
     }
-    return 0;
+    result = values.back();
+    return true;
 }
+
+#define INSTANTIATE_CALCULATOR_TEMPLATES(V) \
+    template class BasicLexer<V>; \
+    template class BasicParser<V>; \
+    template class BasicCalculator<V>;
+
+FOR_EACH_VALUE_TYPE(INSTANTIATE_CALCULATOR_TEMPLATES)
@@ -6,21 +6,21 @@
 #define CC_LABS_CALCULATOR_H
 
 
+#include <cstdint>
 #include <cstdlib>
 #include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <string>
-
-typedef size_t Size;
-typedef char Symbol;
-typedef int Value;
+#include <vector>
+#include "Values.h"
 
 enum TokenType {
     TYPE_UNKNOWN = 0,
     OPERATOR,
     DELIMITER,
     VALUE,
+    IDENTIFIER,
 };
 
 const char *TokenTypeToString(TokenType type);
@@ -44,54 +44,87 @@ enum Delimiter {
     PAREN_CLOSE,
 };
 
-struct Token {
+template<typename V>
+struct BasicToken {
     TokenType type;
     union {
         Operator oper;
-        Value value{};
+        V value{};
         Delimiter delim;
+        /// index in the VariableTable of the lexer
+        uint32_t variable;
     };
 
-    constexpr Token() : type(TYPE_UNKNOWN) {
-        oper = OPER_UNKNOWN;
-        value = 0;
-        delim = DELIM_UNKNOWN;
-    }
+    // every constructor initializes exactly one member of the union, so tokens can be built in constant expressions
+    constexpr BasicToken() : type(TYPE_UNKNOWN), value(0) {}
 
 private:
 
-    constexpr explicit Token(Operator oper) : Token() {
-        this->type = TokenType::OPERATOR;
-        this->oper = oper;
-    }
+    constexpr explicit BasicToken(Operator oper) : type(TokenType::OPERATOR), oper(oper) {}
+
+    constexpr explicit BasicToken(V value) : type(TokenType::VALUE), value(value) {}
+
+    constexpr explicit BasicToken(Delimiter delim) : type(TokenType::DELIMITER), delim(delim) {}
 
-    constexpr explicit Token(Value value) : Token() {
-        this->type = TokenType::VALUE;
-        this->value = value;
+    constexpr BasicToken(TokenType type, uint32_t variable) : type(type), variable(variable) {}
+
+public:
+
+    static constexpr BasicToken makeOperatorToken(Operator oper) {
+        return BasicToken(oper);
     }
 
-    constexpr explicit Token(Delimiter delim) : Token() {
-        this->type = TokenType::DELIMITER;
-        this->delim = delim;
+    static constexpr BasicToken makeDelimiterToken(Delimiter delimiter) {
+        return BasicToken(delimiter);
     }
 
-public:
+    static constexpr BasicToken makeValueToken(V value) {
+        return BasicToken(value);
+    }
 
-    static constexpr Token makeOperatorToken(Operator oper) {
-        return Token(oper);
+    static constexpr BasicToken makeVariableToken(uint32_t variable) {
+        return BasicToken(TokenType::IDENTIFIER, variable);
     }
 
-    static constexpr Token makeDelimiterToken(Delimiter delimiter) {
-        return Token(delimiter);
+};
+
+typedef BasicToken<Value> Token;
+
+/**
+ * Names of the variables met by the lexer, a variable is referred to by its index
+ */
+class VariableTable {
+private:
+    std::vector<std::string> names;
+
+public:
+    VariableTable() = default;
+
+    /// @return index of the variable, it is added if the name is new
+    uint32_t intern(const char *name, Size length) {
+        for (Size i = 0; i < names.size(); ++i) {
+            if (names[i].size() == length && std::memcmp(names[i].data(), name, length) == 0) {
+                return static_cast<uint32_t>(i);
+            }
+        }
+        names.emplace_back(name, length);
+        return static_cast<uint32_t>(names.size() - 1);
     }
 
-    static constexpr Token makeValueToken(Value value) {
-        return Token(value);
+    const std::string &name(uint32_t variable) const {
+        return names[variable];
     }
 
+    Size size() const {
+        return names.size();
+    }
 };
 
-class Lexer {
+/**
+ * Splits the source into tokens, integer literals are converted to V
+ */
+template<typename V>
+class BasicLexer {
 private:
 
     const static Size stashBufferCap = 128;
@@ -100,25 +133,62 @@ private:
     int stashBufferPtr;
     Symbol stashBuffer[stashBufferCap]{};
 
-    int readBufferPtr;
+    Size readBufferPtr;
     Size readBufferSize;
     Symbol readBuffer[readBufferCap]{};
 
+    /// stream input, stdin if not set
+    FILE *input = nullptr;
+    /// replaces readBuffer, if set
+    Symbol *streamBuffer = nullptr;
+    Size streamBufferCap = 0;
+
     const char *source = nullptr;
+    VariableTable *variables = nullptr;
+    /// skipped spaces are counted by the trace
+    bool traceSpaces = true;
 
 public:
 
-    constexpr Lexer() :
+    /// reads stdin
+    constexpr BasicLexer() :
             stashBufferPtr(0),
             readBufferPtr(0),
-            readBufferSize(readBufferCap) {}
+            readBufferSize(0) {}
+
+    /**
+     * Reads the stream through the buffer, which should be large for big inputs
+     * Symbols are consumed from the stream only as tokens are requested
+     */
+    constexpr BasicLexer(FILE *input, Symbol *buffer, Size capacity) :
+            BasicLexer() {
+        this->input = input;
+        this->streamBuffer = buffer;
+        this->streamBufferCap = capacity;
+    }
 
-    constexpr explicit Lexer(const char *source) :
-            Lexer() {
+    constexpr explicit BasicLexer(const char *source) :
+            BasicLexer() {
         this->source = source;
     }
 
-    Token nextToken();
+    /// identifiers are interned into the table, without it they are unknown tokens
+    constexpr BasicLexer(const char *source, VariableTable *variables) :
+            BasicLexer(source) {
+        this->variables = variables;
+    }
+
+    BasicToken<V> nextToken();
+
+    /// the source is lexed again by the parser, so its spaces are not counted twice
+    void untraceSpaces() {
+        traceSpaces = false;
+    }
+
+    /// returns true, if there are no more symbols in the source
+    bool atEnd() {
+        return nextSymbol() == '\0';
+    }
 
 
 private:
@@ -127,9 +197,16 @@ private:
         return symbol >= '0' && symbol <= '9';
     }
 
+    static inline bool isLetter(Symbol symbol) {
+        return (symbol >= 'a' && symbol <= 'z') || (symbol >= 'A' && symbol <= 'Z') || symbol == '_';
+    }
+
+    /// symbols beyond the capacity are dropped, the last byte keeps the stash null-terminated
     int stashSymbol(Symbol symbol) {
-        stashBuffer[stashBufferPtr] = symbol;
-        return ++stashBufferPtr;
+        if (stashBufferPtr + 1 < static_cast<int>(stashBufferCap)) {
+            stashBuffer[stashBufferPtr++] = symbol;
+        }
+        return stashBufferPtr;
     }
 
     Symbol nextSymbol();
@@ -137,6 +214,8 @@ private:
 
 };
 
+typedef BasicLexer<Value> Lexer;
+
 enum ExpressionType {
     EXPRESSION,
     RELATION,
@@ -144,94 +223,134 @@ enum ExpressionType {
     FACTOR,
     PRIMARY,
     INTEGER,
+    VARIABLE,
 };
 
-struct Expression {
-    ExpressionType type;
+/// index of a node in the NodeArena
+typedef uint32_t NodeIndex;
 
-    explicit Expression(ExpressionType type) : type(type) {}
-};
-
-struct Integer : Expression {
-    Value value;
+const NodeIndex NO_NODE = UINT32_MAX;
 
-    explicit Integer(Value value) :
-            Expression(INTEGER),
-            value(value) {}
+/**
+ * Node of the flat AST, nodes refer to each other by index in their arena
+ * RELATION : operand is the left TERM, next is the right TERM or NO_NODE
+ * TERM, FACTOR : operand is the FACTOR or PRIMARY, next is the following link of the chain,
+ *     oper of a link is applied to the accumulated value and its operand
+ * PRIMARY : operand is the INTEGER, the VARIABLE or the nested EXPRESSION
+ * INTEGER : value
+ * VARIABLE : operand is the index of the variable
+ */
+template<typename V>
+struct BasicNode {
+    ExpressionType type;
+    Operator oper;
+    union {
+        NodeIndex operand;
+        V value;
+    };
+    NodeIndex next;
 };
 
-struct Primary : Expression {
-    Integer *integer;
-    Expression *expression;
+typedef BasicNode<Value> Node;
 
-    explicit Primary(Integer *integer) :
-            Expression(PRIMARY),
-            integer(integer), expression(nullptr) {}
+/**
+ * Contiguous storage of all nodes of an expression
+ * The nodes are freed at once by reset(), the capacity is kept for the next expression
+ */
+template<typename V>
+class BasicNodeArena {
+private:
+    std::vector<BasicNode<V>> nodes;
 
-    explicit Primary(Expression *expression) :
-            Expression(PRIMARY),
-            integer(nullptr), expression(expression) {}
-};
+public:
+    BasicNodeArena() = default;
 
-struct Factor : Expression {
-    Primary *operand;
-    Operator oper{};
-    Factor *next{};
+    NodeIndex add(ExpressionType type, Operator oper, NodeIndex operand) {
+        if (nodes.size() >= NO_NODE) {
+            std::fprintf(stderr, "arena error : more than %u nodes in the expression\n", NO_NODE - 1);
+            std::exit(-1);
+        }
+        BasicNode<V> node{type, oper, {operand}, NO_NODE};
+        nodes.push_back(node);
+        return static_cast<NodeIndex>(nodes.size() - 1);
+    }
 
-    explicit Factor(Primary *left) :
-            Expression(FACTOR),
-            operand(left) {}
+    NodeIndex addInteger(V value) {
+        NodeIndex index = add(INTEGER, OPER_UNKNOWN, NO_NODE);
+        nodes[index].value = value;
+        return index;
+    }
 
-    explicit Factor(Primary *left, Operator oper, Factor *prev) :
-            Expression(FACTOR),
-            operand(left), oper(oper), next(nullptr) { prev->next = this; }
-};
+    BasicNode<V> &operator[](NodeIndex index) {
+        return nodes[index];
+    }
 
-struct Term : Expression {
-    Factor *operand;
-    Operator oper{};
-    Term *next{};
+    const BasicNode<V> &operator[](NodeIndex index) const {
+        return nodes[index];
+    }
 
-    explicit Term(Factor *left) :
-            Expression(TERM),
-            operand(left) {}
+    Size size() const {
+        return nodes.size();
+    }
 
-    explicit Term(Factor *left, Operator oper, Term *prev) :
-            Expression(TERM),
-            operand(left), oper(oper), next(nullptr) { prev->next = this; }
+    void reset() {
+        nodes.clear();
+    }
 };
 
-struct Relation : Expression {
-    Term *left;
-    Operator oper{};
-    Term *right{};
+typedef BasicNodeArena<Value> NodeArena;
 
-    explicit Relation(Term *left) :
-            Expression(RELATION),
-            left(left) {}
 
-    explicit Relation(Term *left, Operator oper, Term *right) :
-            Expression(RELATION),
-            left(left), oper(oper), right(right) {}
+/**
+ * Expression of the iterative parser which is not complete yet, one per open parenthesis
+ * Its TERM and FACTOR chains are extended at their last links
+ */
+struct ParseFrame {
+    NodeIndex relation;
+    /// last link of the TERM chain of the current side of the relation
+    NodeIndex term;
+    /// last link of the FACTOR chain, the next PRIMARY becomes its operand
+    NodeIndex factor;
 };
 
-
-class Parser {
+/**
+ * Precedence-climbing parser without recursion: open parentheses are kept on a heap stack of frames,
+ * so any nesting depth is parsed in linear time. Builds the same tree as the grammar
+ *     expression = relation ; relation = term [("<" | ">" | "=") term] ;
+ *     term = factor {("+" | "-") factor} ; factor = primary {("*" | "/") primary} ;
+ *     primary = "(" expression ")" | variable | integer
+ */
+template<typename V>
+class BasicParser {
 private:
-    Lexer &lexer;
-    Token token;
+    /// binding power of operators, tokens which are not operators bind with 0 and end the expression
+    static const int relationPower = 1;
+    static const int termPower = 2;
+    static const int factorPower = 3;
+
+    BasicLexer<V> &lexer;
+    BasicNodeArena<V> &arena;
+    BasicToken<V> token;
     bool needReadToken = true;
+    bool failed = false;
 
 public:
-    constexpr explicit Parser(Lexer &lexer) : lexer(lexer) {}
+    /// nodes are appended to the arena, the caller resets it after the expression is calculated
+    constexpr BasicParser(BasicLexer<V> &lexer, BasicNodeArena<V> &arena) : lexer(lexer), arena(arena) {}
 
-    Expression *parse() {
+    /// @return index of the root node
+    NodeIndex parse() {
         return parseExpression();
     }
 
+    /// true, if a misplaced token was reported and read as 0, the tree is complete anyway
+    bool hasErrors() const {
+        return failed;
+    }
+
 private:
 
-    Token &peekToken() {
+    BasicToken<V> &peekToken() {
         if (needReadToken) {
             token = lexer.nextToken();
             needReadToken = false;
@@ -241,43 +360,164 @@ private:
 
 
     static inline void reportError(const char *msg) {
-        std::printf("parsing error : %s", msg);
+        std::fprintf(stderr, "parsing error : %s\n", msg);
     }
 
     void commitToken() {
         needReadToken = true;
     }
 
-    Expression *parseExpression();
+    static int bindingPower(const BasicToken<V> &token);
 
-    Relation *parseRelation();
+    /// adds the first TERM and FACTOR of a side of the relation
+    ParseFrame openSide(NodeIndex relation, NodeIndex term);
 
-    Term *parseTerm();
+    NodeIndex parseExpression();
 
-    Factor *parseFactor();
+    /// parses a primary which is not parenthesized
+    NodeIndex parsePrimary();
 
-    Primary *parsePrimary();
+    NodeIndex parseInteger();
 
-    Integer *parseInteger();
+    NodeIndex parseVariable();
 
 };
 
+typedef BasicParser<Value> Parser;
+
+/// pending step of walkPostfix()
+struct WalkStep {
+    enum Kind : uint8_t {
+        /// visit the node and its operands
+        VISIT,
+        /// continue the TERM or FACTOR chain after the link
+        CHAIN,
+        /// apply the operator to the values of both operands
+        APPLY,
+    };
+    Kind kind;
+    Operator oper;
+    NodeIndex index;
+};
 
-class Calculator {
+/**
+ * Visits the tree in postfix order without recursion, any nesting depth is walked in linear time
+ * The walk descends along left operands directly, only right operands and operators wait on the stack
+ * @param steps Stack of pending steps, reused between walks
+ * @param leaf Called with every INTEGER and VARIABLE node
+ * @param apply Called with the operator of every RELATION and chain link after its operands
+ */
+template<typename V, typename Leaf, typename Apply>
+void walkPostfix(const BasicNodeArena<V> &arena, NodeIndex root, std::vector<WalkStep> &steps,
+                 Leaf &&leaf, Apply &&apply) {
+    steps.clear();
+    steps.push_back(WalkStep{WalkStep::VISIT, OPER_UNKNOWN, root});
+    while (!steps.empty()) {
+        WalkStep step = steps.back();
+        steps.pop_back();
+        if (step.kind == WalkStep::APPLY) {
+            apply(step.oper);
+            continue;
+        }
+        NodeIndex index = step.index;
+        if (step.kind == WalkStep::CHAIN) {
+            NodeIndex link = arena[index].next;
+            if (link == NO_NODE) {
+                continue;
+            }
+            // the operand of the link is visited first, then its operator is applied and the chain continues
+            steps.push_back(WalkStep{WalkStep::CHAIN, OPER_UNKNOWN, link});
+            steps.push_back(WalkStep{WalkStep::APPLY, arena[link].oper, NO_NODE});
+            index = arena[link].operand;
+        }
+        bool descending = true;
+        while (descending) {
+            const BasicNode<V> &node = arena[index];
+            switch (node.type) {
+                case ExpressionType::EXPRESSION:
+                case ExpressionType::RELATION: {
+                    if (node.next != NO_NODE) {
+                        steps.push_back(WalkStep{WalkStep::APPLY, node.oper, NO_NODE});
+                        steps.push_back(WalkStep{WalkStep::VISIT, OPER_UNKNOWN, node.next});
+                    }
+                    index = node.operand;
+                    break;
+                }
+                case ExpressionType::TERM:
+                case ExpressionType::FACTOR: {
+                    if (node.next != NO_NODE) {
+                        steps.push_back(WalkStep{WalkStep::CHAIN, OPER_UNKNOWN, index});
+                    }
+                    index = node.operand;
+                    break;
+                }
+                case ExpressionType::PRIMARY: {
+                    index = node.operand;
+                    break;
+                }
+                case ExpressionType::INTEGER:
+                case ExpressionType::VARIABLE: {
+                    leaf(node);
+                    descending = false;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Applies the binary operator, comparisons give 1 or 0
+ * Shared by the runtime and the compile-time engines, division by zero is not a constant expression
+ * Division goes through ValueTraits, so the minimal value divided by -1 wraps around instead of trapping
+ */
+template<typename V>
+constexpr V applyOperation(V v1, Operator oper, V v2) {
+    switch (oper) {
+        case Operator::GREATER_THAN: return v1 > v2 ? V(1) : V(0);
+        case Operator::LESS_THAN: return v1 < v2 ? V(1) : V(0);
+        case Operator::EQUAL_TO: return v1 == v2 ? V(1) : V(0);
+        case Operator::ADDITION: return v1 + v2;
+        case Operator::SUBTRACTION: return v1 - v2;
+        case Operator::MULTIPLICATION: return v1 * v2;
+        case Operator::DIVISION: return ValueTraits<V>::divide(v1, v2);
+        default: return V(-1);
+    }
+}
+
+template<typename V>
+class BasicCalculator {
 
 public:
-    Calculator() = default;
+    BasicCalculator() = default;
 
-    static Value calculate(Expression *expression);
+    /**
+     * Walks the tree with walkPostfix(), so deeply nested expressions do not overflow the call stack
+     * @param result Value of the expression, untouched on error
+     * @param variables Values of the variables by their index, nullptr if the expression has none
+     * @return false on division by zero, overflow of a checked type or a missing variable, like VirtualMachine::run()
+     */
+    static bool calculate(const BasicNodeArena<V> &arena, NodeIndex index, V &result, const V *variables = nullptr);
 
 private:
 
-    static Value applyOperator(Value v1, Operator oper, Value v2);
+    /// @return false on division by zero or overflow of a checked type, the result may be set then
+    static bool applyOperator(V v1, Operator oper, V v2, V &result);
 
     static inline void reportError(const char *msg) {
-        printf("calculation error : %s", msg);
+        std::fprintf(stderr, "calculation error : %s\n", msg);
     }
 
 };
 
+typedef BasicCalculator<Value> Calculator;
+
+// the members are defined in Calculator.cpp for every type of FOR_EACH_VALUE_TYPE
+#define EXTERN_CALCULATOR_TEMPLATES(V) \
+    extern template class BasicLexer<V>; \
+    extern template class BasicParser<V>; \
+    extern template class BasicCalculator<V>;
+
+FOR_EACH_VALUE_TYPE(EXTERN_CALCULATOR_TEMPLATES)
+
 #endif //CC_LABS_CALCULATOR_H
@@ -0,0 +1,300 @@
+/**
+ * Block-at-a-time evaluation of compiled expressions over integer columns
+ */
+
+#include <charconv>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "ColumnEvaluator.h"
+#include "profile.h"
+#include "Trace.h"
+
+#if defined(__AVX2__)
+typedef __m256i Lanes;
+const Size laneCount = 8;
+
+static inline Lanes loadLanes(const Value *ptr) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ptr));
+}
+
+static inline void storeLanes(Value *ptr, Lanes lanes) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(ptr), lanes);
+}
+#elif defined(__SSE2__)
+typedef __m128i Lanes;
+const Size laneCount = 4;
+
+static inline Lanes loadLanes(const Value *ptr) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr));
+}
+
+static inline void storeLanes(Value *ptr, Lanes lanes) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(ptr), lanes);
+}
+#endif
+
+/// arithmetic wraps around like the lanes do, instead of overflowing
+template<OpCode code>
+static inline Value applyScalar(Value x, Value y) {
+    auto ux = static_cast<uint32_t>(x);
+    auto uy = static_cast<uint32_t>(y);
+    if constexpr (code == OP_ADDITION) {
+        return static_cast<Value>(ux + uy);
+    } else if constexpr (code == OP_SUBTRACTION) {
+        return static_cast<Value>(ux - uy);
+    } else if constexpr (code == OP_MULTIPLICATION) {
+        return static_cast<Value>(ux * uy);
+    } else if constexpr (code == OP_GREATER_THAN) {
+        return x > y ? 1 : 0;
+    } else if constexpr (code == OP_LESS_THAN) {
+        return x < y ? 1 : 0;
+    } else {
+        return x == y ? 1 : 0;
+    }
+}
+
+#if defined(__AVX2__)
+template<OpCode code>
+static inline Lanes applyLanes(Lanes x, Lanes y) {
+    if constexpr (code == OP_ADDITION) {
+        return _mm256_add_epi32(x, y);
+    } else if constexpr (code == OP_SUBTRACTION) {
+        return _mm256_sub_epi32(x, y);
+    } else if constexpr (code == OP_MULTIPLICATION) {
+        return _mm256_mullo_epi32(x, y);
+    } else if constexpr (code == OP_GREATER_THAN) {
+        return _mm256_and_si256(_mm256_cmpgt_epi32(x, y), _mm256_set1_epi32(1));
+    } else if constexpr (code == OP_LESS_THAN) {
+        return _mm256_and_si256(_mm256_cmpgt_epi32(y, x), _mm256_set1_epi32(1));
+    } else {
+        return _mm256_and_si256(_mm256_cmpeq_epi32(x, y), _mm256_set1_epi32(1));
+    }
+}
+#elif defined(__SSE2__)
+template<OpCode code>
+static inline Lanes applyLanes(Lanes x, Lanes y) {
+    if constexpr (code == OP_ADDITION) {
+        return _mm_add_epi32(x, y);
+    } else if constexpr (code == OP_SUBTRACTION) {
+        return _mm_sub_epi32(x, y);
+    } else if constexpr (code == OP_MULTIPLICATION) {
+#if defined(__SSE4_1__)
+        return _mm_mullo_epi32(x, y);
+#else
+        // low halves of the products of even and odd lanes, interleaved back
+        Lanes even = _mm_mul_epu32(x, y);
+        Lanes odd = _mm_mul_epu32(_mm_srli_si128(x, 4), _mm_srli_si128(y, 4));
+        return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                                  _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+#endif
+    } else if constexpr (code == OP_GREATER_THAN) {
+        return _mm_and_si128(_mm_cmpgt_epi32(x, y), _mm_set1_epi32(1));
+    } else if constexpr (code == OP_LESS_THAN) {
+        return _mm_and_si128(_mm_cmplt_epi32(x, y), _mm_set1_epi32(1));
+    } else {
+        return _mm_and_si128(_mm_cmpeq_epi32(x, y), _mm_set1_epi32(1));
+    }
+}
+#endif
+
+template<OpCode code>
+static void binaryKernel(const Value *x, const Value *y, Value *out, Size count) {
+    Size i = 0;
+#if defined(__AVX2__) || defined(__SSE2__)
+    for (; i + laneCount <= count; i += laneCount) {
+        storeLanes(out + i, applyLanes<code>(loadLanes(x + i), loadLanes(y + i)));
+    }
+#endif
+    for (; i < count; ++i) {
+        out[i] = applyScalar<code>(x[i], y[i]);
+    }
+}
+
+/**
+ * There is no integer division in vector instructions, rows divided by zero are marked invalid
+ * @return count of rows divided by zero
+ */
+static Size divisionKernel(const Value *x, const Value *y, Value *out, uint8_t *valid, Size count) {
+    Size zeros = 0;
+    for (Size i = 0; i < count; ++i) {
+        if (y[i] == 0) {
+            out[i] = 0;
+            valid[i] = 0;
+            ++zeros;
+        } else if (y[i] == -1) {
+            // the minimal value divided by -1 overflows
+            out[i] = static_cast<Value>(0U - static_cast<uint32_t>(x[i]));
+        } else {
+            out[i] = x[i] / y[i];
+        }
+    }
+    return zeros;
+}
+
+/// checks stack depth and variable indices once, so blocks are run without checks
+static bool isValidProgram(const Program &program, Size columnCount) {
+    Size depth = 0;
+    for (const Instruction &instruction : program.code) {
+        if (instruction.code == OP_PUSH) {
+            ++depth;
+        } else if (instruction.code == OP_LOAD) {
+            if (instruction.variable >= columnCount) {
+                return false;
+            }
+            ++depth;
+        } else if (instruction.code > OP_DIVISION || depth < 2) {
+            return false;
+        } else {
+            --depth;
+        }
+        if (depth > program.maxStack) {
+            return false;
+        }
+    }
+    return depth == 1;
+}
+
+bool ColumnEvaluator::run(const Program &program, const Value *const *columns, Size columnCount, Size rowCount,
+                          Value *result, uint8_t *valid) {
+    PROFILE_SCOPE("ColumnEvaluator::run")
+    if (!isValidProgram(program, columnCount)) {
+        std::fprintf(stderr, "execution error : malformed program\n");
+        return false;
+    }
+    scratch.resize(program.maxStack * columnBlockSize);
+    registers.resize(program.maxStack);
+    constants.clear();
+    for (const Instruction &instruction : program.code) {
+        if (instruction.code == OP_PUSH) {
+            constants.insert(constants.end(), columnBlockSize, instruction.value);
+        }
+    }
+
+    for (Size first = 0; first < rowCount; first += columnBlockSize) {
+        Size count = std::min(columnBlockSize, rowCount - first);
+        uint8_t *blockValid = valid + first;
+        std::memset(blockValid, 1, count);
+        Size depth = 0;
+        Size constant = 0;
+        for (const Instruction &instruction : program.code) {
+            // the result of an operator takes the scratch block of its stack slot
+            Value *out = depth >= 2 ? &scratch[(depth - 2) * columnBlockSize] : nullptr;
+            const Value *x = depth >= 2 ? registers[depth - 2] : nullptr;
+            const Value *y = depth >= 1 ? registers[depth - 1] : nullptr;
+            TRACE_START(start);
+            switch (instruction.code) {
+                case OP_PUSH: {
+                    registers[depth++] = &constants[constant++ * columnBlockSize];
+                    continue;
+                }
+                case OP_LOAD: {
+                    registers[depth++] = columns[instruction.variable] + first;
+                    continue;
+                }
+                case OP_GREATER_THAN: {
+                    binaryKernel<OP_GREATER_THAN>(x, y, out, count);
+                    break;
+                }
+                case OP_LESS_THAN: {
+                    binaryKernel<OP_LESS_THAN>(x, y, out, count);
+                    break;
+                }
+                case OP_EQUAL_TO: {
+                    binaryKernel<OP_EQUAL_TO>(x, y, out, count);
+                    break;
+                }
+                case OP_ADDITION: {
+                    binaryKernel<OP_ADDITION>(x, y, out, count);
+                    break;
+                }
+                case OP_SUBTRACTION: {
+                    binaryKernel<OP_SUBTRACTION>(x, y, out, count);
+                    break;
+                }
+                case OP_MULTIPLICATION: {
+                    binaryKernel<OP_MULTIPLICATION>(x, y, out, count);
+                    break;
+                }
+                case OP_DIVISION: {
+                    Size zeros = divisionKernel(x, y, out, blockValid, count);
+                    if (zeros > 0) {
+                        TRACE_DIVISION_BY_ZERO(0, zeros);
+                    }
+                    break;
+                }
+            }
+            TRACE_KERNEL(opCodeToOperator(instruction.code), count, start);
+            registers[--depth - 1] = out;
+        }
+        const Value *values = registers[0];
+        for (Size i = 0; i < count; ++i) {
+            result[first + i] = blockValid[i] ? values[i] : 0;
+        }
+    }
+    return true;
+}
+
+Size maskRows(const Value *values, const uint8_t *valid, Size rowCount, uint8_t *mask) {
+    Size selected = 0;
+    for (Size i = 0; i < rowCount; ++i) {
+        mask[i] = static_cast<uint8_t>(valid[i] & (values[i] != 0 ? 1 : 0));
+        selected += mask[i];
+    }
+    return selected;
+}
+
+bool evaluateColumns(const char *expression, const ColumnTable &table, bool filter, FILE *out) {
+    VariableTable variables;
+    NodeArena arena;
+    Lexer lexer(expression, &variables);
+    Parser parser(lexer, arena);
+    NodeIndex root = parser.parse();
+    Program program;
+    Compiler::compile(arena, root, program);
+    arena.reset();
+
+    std::vector<const Value *> columns(variables.size());
+    for (uint32_t i = 0; i < variables.size(); ++i) {
+        int column = table.find(variables.name(i));
+        if (column < 0) {
+            std::fprintf(stderr, "no column named %s\n", variables.name(i).c_str());
+            return false;
+        }
+        columns[i] = table.column(static_cast<Size>(column));
+    }
+
+    ColumnEvaluator evaluator;
+    std::vector<Value> values(table.rowCount());
+    std::vector<uint8_t> valid(table.rowCount());
+    if (!evaluator.run(program, columns.data(), columns.size(), table.rowCount(), values.data(), valid.data())) {
+        return false;
+    }
+    if (filter) {
+        maskRows(values.data(), valid.data(), table.rowCount(), valid.data());
+    }
+
+    // rows are written in blocks, a line is at most 20 digits of a row index or 11 symbols of a value
+    std::vector<char> text(columnBlockSize * 21);
+    for (Size first = 0; first < table.rowCount(); first += columnBlockSize) {
+        Size last = std::min(first + columnBlockSize, table.rowCount());
+        char *ptr = text.data();
+        for (Size i = first; i < last; ++i) {
+            if (filter) {
+                if (valid[i]) {
+                    ptr = std::to_chars(ptr, ptr + 20, static_cast<uint64_t>(i)).ptr;
+                    *ptr++ = '\n';
+                }
+            } else if (valid[i]) {
+                ptr = std::to_chars(ptr, ptr + 11, values[i]).ptr;
+                *ptr++ = '\n';
+            } else {
+                std::memcpy(ptr, "error\n", 6);
+                ptr += 6;
+            }
+        }
+        std::fwrite(text.data(), 1, static_cast<Size>(ptr - text.data()), out);
+    }
+    std::fflush(out);
+    return true;
+}
@@ -0,0 +1,57 @@
+/**
+ * Block-at-a-time evaluation of compiled expressions over integer columns
+ */
+
+#ifndef CC_LABS_COLUMN_EVALUATOR_H
+#define CC_LABS_COLUMN_EVALUATOR_H
+
+#include <cstdint>
+#include <vector>
+#include "Bytecode.h"
+#include "ColumnTable.h"
+
+/// rows evaluated at once, the registers of a block stay in L1 cache
+const Size columnBlockSize = 1024;
+
+/**
+ * Runs a program over blocks of rows, every stack slot of the virtual machine becomes a register
+ * of columnBlockSize values and every instruction a vector kernel over the whole block
+ * Comparisons produce 0/1 values, so their results can be used as masks and in arithmetic alike
+ */
+class ColumnEvaluator {
+private:
+    std::vector<Value> scratch;
+    /// one broadcast block per OP_PUSH instruction
+    std::vector<Value> constants;
+    std::vector<const Value *> registers;
+
+public:
+    ColumnEvaluator() = default;
+
+    /**
+     * @param columns Column of every variable by its index
+     * @param columnCount Count of columns, OP_LOAD instructions may not refer beyond them
+     * @param result Value of every row, 0 for invalid rows
+     * @param valid Set to 1 for evaluated rows, 0 for rows with division by zero
+     * @return false, if the program is malformed
+     */
+    bool run(const Program &program, const Value *const *columns, Size columnCount, Size rowCount,
+             Value *result, uint8_t *valid);
+
+};
+
+/**
+ * Builds the selection mask of valid rows whose value is not zero
+ * @return count of selected rows
+ */
+Size maskRows(const Value *values, const uint8_t *valid, Size rowCount, uint8_t *mask);
+
+/**
+ * Compiles the expression, binds its variables to the columns with the same names and evaluates it
+ * Prints one value per row, "error" for rows with division by zero, or with filter the indices of rows
+ * where the value is not zero
+ * @return false, if the expression refers to a missing column
+ */
+bool evaluateColumns(const char *expression, const ColumnTable &table, bool filter, FILE *out);
+
+#endif //CC_LABS_COLUMN_EVALUATOR_H
@@ -0,0 +1,240 @@
+/**
+ * Integer columns read from CSV or mapped from the binary column format
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ColumnTable.h"
+
+static inline Size alignUp(Size value, Size alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+ColumnTable::~ColumnTable() {
+    close();
+}
+
+void ColumnTable::close() {
+    if (mapping != nullptr) {
+        munmap(mapping, mappingSize);
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+    names.clear();
+    columns.clear();
+    storage.clear();
+    rows = 0;
+}
+
+bool ColumnTable::open(const char *path) {
+    FILE *file = std::fopen(path, "rb");
+    if (!file) {
+        std::fprintf(stderr, "Unable to read table %s\n", path);
+        return false;
+    }
+    uint32_t magic = 0;
+    Size read = std::fread(&magic, 1, sizeof(magic), file);
+    std::fclose(file);
+    if (read == sizeof(magic) && magic == columnTableMagic) {
+        return openBinary(path);
+    }
+    return readCsv(path);
+}
+
+/// parses comma-separated fields of the line, spaces around fields are skipped
+static void splitFields(char *line, std::vector<char *> &fields) {
+    fields.clear();
+    char *field = line;
+    while (true) {
+        while (*field == ' ') {
+            ++field;
+        }
+        char *end = std::strchr(field, ',');
+        char *next = end == nullptr ? nullptr : end + 1;
+        if (end == nullptr) {
+            end = field + std::strlen(field);
+        }
+        while (end > field && (end[-1] == ' ' || end[-1] == '\r')) {
+            --end;
+        }
+        *end = '\0';
+        fields.push_back(field);
+        if (next == nullptr) {
+            return;
+        }
+        field = next;
+    }
+}
+
+bool ColumnTable::readCsv(const char *path) {
+    close();
+    FILE *file = std::fopen(path, "rb");
+    if (!file) {
+        std::fprintf(stderr, "Unable to read table %s\n", path);
+        return false;
+    }
+    char *line = nullptr;
+    size_t lineCap = 0;
+    ssize_t length;
+    std::vector<char *> fields;
+    Size lineNumber = 0;
+    bool success = true;
+    while ((length = getline(&line, &lineCap, file)) >= 0) {
+        ++lineNumber;
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+            line[--length] = '\0';
+        }
+        if (length == 0) {
+            continue;
+        }
+        splitFields(line, fields);
+        if (names.empty()) {
+            names.assign(fields.begin(), fields.end());
+            storage.resize(names.size());
+            continue;
+        }
+        if (fields.size() != names.size()) {
+            std::fprintf(stderr, "%s:%zu: expected %zu fields, got %zu\n", path, lineNumber, names.size(),
+                         fields.size());
+            success = false;
+            break;
+        }
+        for (Size i = 0; i < fields.size(); ++i) {
+            char *end = nullptr;
+            long value = std::strtol(fields[i], &end, 10);
+            if (end == fields[i] || *end != '\0') {
+                std::fprintf(stderr, "%s:%zu: '%s' is not an integer\n", path, lineNumber, fields[i]);
+                success = false;
+                break;
+            }
+            storage[i].push_back(static_cast<Value>(value));
+        }
+        if (!success) {
+            break;
+        }
+        ++rows;
+    }
+    std::free(line);
+    std::fclose(file);
+    if (!success) {
+        close();
+        return false;
+    }
+    for (auto &column : storage) {
+        columns.push_back(column.data());
+    }
+    return true;
+}
+
+/// checks that all columns and names lie within the file
+static bool isValidHeader(const ColumnTableHeader *header, Size fileSize) {
+    if (header->magic != columnTableMagic || header->version != columnTableVersion ||
+        header->namesOffset < sizeof(ColumnTableHeader) || header->namesOffset > header->dataOffset ||
+        header->dataOffset > fileSize || header->dataOffset % columnTableAlignment != 0 ||
+        header->columnStride % columnTableAlignment != 0 ||
+        header->rowCount > header->columnStride / sizeof(Value)) {
+        return false;
+    }
+    if (header->columnCount == 0 || header->rowCount == 0) {
+        return true;
+    }
+    Size dataSize = fileSize - header->dataOffset;
+    Size columnBytes = header->rowCount * sizeof(Value);
+    return dataSize >= columnBytes && (dataSize - columnBytes) / header->columnStride >= header->columnCount - 1U;
+}
+
+bool ColumnTable::openBinary(const char *path) {
+    close();
+    int fd = ::open(path, O_RDONLY);
+    if (fd < 0) {
+        std::fprintf(stderr, "Unable to read table %s\n", path);
+        return false;
+    }
+    struct stat fileStat{};
+    if (fstat(fd, &fileStat) != 0 || static_cast<Size>(fileStat.st_size) < sizeof(ColumnTableHeader)) {
+        std::fprintf(stderr, "%s is not a column table\n", path);
+        ::close(fd);
+        return false;
+    }
+    mappingSize = static_cast<Size>(fileStat.st_size);
+    mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        mapping = nullptr;
+        mappingSize = 0;
+        std::fprintf(stderr, "Unable to map table %s\n", path);
+        return false;
+    }
+    madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+    auto data = static_cast<const uint8_t *>(mapping);
+    auto header = reinterpret_cast<const ColumnTableHeader *>(data);
+    if (!isValidHeader(header, mappingSize)) {
+        std::fprintf(stderr, "%s is not a valid column table\n", path);
+        close();
+        return false;
+    }
+    const char *name = reinterpret_cast<const char *>(data + header->namesOffset);
+    const char *namesEnd = reinterpret_cast<const char *>(data + header->dataOffset);
+    for (uint32_t i = 0; i < header->columnCount; ++i) {
+        auto end = static_cast<const char *>(std::memchr(name, '\0', static_cast<Size>(namesEnd - name)));
+        if (end == nullptr) {
+            std::fprintf(stderr, "%s is not a valid column table\n", path);
+            close();
+            return false;
+        }
+        names.emplace_back(name, static_cast<Size>(end - name));
+        columns.push_back(reinterpret_cast<const Value *>(data + header->dataOffset + i * header->columnStride));
+        name = end + 1;
+    }
+    rows = header->rowCount;
+    return true;
+}
+
+bool ColumnTable::writeBinary(const char *path) const {
+    FILE *file = std::fopen(path, "wb");
+    if (!file) {
+        std::fprintf(stderr, "Unable to write table %s\n", path);
+        return false;
+    }
+    ColumnTableHeader header{};
+    header.magic = columnTableMagic;
+    header.version = columnTableVersion;
+    header.columnCount = static_cast<uint32_t>(columns.size());
+    header.rowCount = rows;
+    header.namesOffset = sizeof(ColumnTableHeader);
+    Size namesSize = 0;
+    for (auto &name : names) {
+        namesSize += name.size() + 1;
+    }
+    header.dataOffset = alignUp(header.namesOffset + namesSize, columnTableAlignment);
+    header.columnStride = alignUp(rows * sizeof(Value), columnTableAlignment);
+
+    static const char padding[columnTableAlignment] = {};
+    bool success = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    for (auto &name : names) {
+        success = success && std::fwrite(name.c_str(), 1, name.size() + 1, file) == name.size() + 1;
+    }
+    Size written = header.namesOffset + namesSize;
+    success = success && std::fwrite(padding, 1, header.dataOffset - written, file) == header.dataOffset - written;
+    for (auto column : columns) {
+        Size columnBytes = rows * sizeof(Value);
+        success = success && std::fwrite(column, 1, columnBytes, file) == columnBytes &&
+                  std::fwrite(padding, 1, header.columnStride - columnBytes, file) == header.columnStride - columnBytes;
+    }
+    success = std::fclose(file) == 0 && success;
+    if (!success) {
+        std::fprintf(stderr, "Unable to write table %s\n", path);
+    }
+    return success;
+}
+
+int ColumnTable::find(const std::string &name) const {
+    for (Size i = 0; i < names.size(); ++i) {
+        if (names[i] == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,100 @@
+/**
+ * Integer columns read from CSV or mapped from the binary column format
+ */
+
+#ifndef CC_LABS_COLUMN_TABLE_H
+#define CC_LABS_COLUMN_TABLE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Calculator.h"
+
+/// "ECOL" in little-endian
+const uint32_t columnTableMagic = 0x4c4f4345U;
+const uint32_t columnTableVersion = 1;
+/// alignment of columns in the binary format
+const Size columnTableAlignment = 64;
+
+/**
+ * Binary table header
+ * The file is laid out as follows, all integers are little-endian:
+ *   ColumnTableHeader
+ *   names                                   - null-terminated column names
+ *   columns[columnCount]                    - rowCount values each, every column is 64-byte aligned
+ */
+struct ColumnTableHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t columnCount;
+    uint32_t reserved;
+    uint64_t rowCount;
+    uint64_t namesOffset;
+    uint64_t dataOffset;
+    /// distance between the starts of adjacent columns
+    uint64_t columnStride;
+};
+
+class ColumnTable {
+private:
+    std::vector<std::string> names;
+    std::vector<const Value *> columns;
+    Size rows = 0;
+    /// columns read from CSV
+    std::vector<std::vector<Value>> storage;
+    void *mapping = nullptr;
+    Size mappingSize = 0;
+
+public:
+    ColumnTable() = default;
+
+    ColumnTable(const ColumnTable &) = delete;
+
+    ColumnTable &operator=(const ColumnTable &) = delete;
+
+    ~ColumnTable();
+
+    /**
+     * Reads the table, the format is detected by the magic
+     * @return false, if the file is missing or malformed, the error is reported to stderr
+     */
+    bool open(const char *path);
+
+    /**
+     * Reads a CSV table: the first line holds column names, every other non-empty line
+     * holds one decimal integer per column
+     */
+    bool readCsv(const char *path);
+
+    /// maps the binary table into memory, columns are not copied
+    bool openBinary(const char *path);
+
+    /// @return false, if the file cannot be written
+    bool writeBinary(const char *path) const;
+
+    /// @return index of the column, -1 if there is no such column
+    int find(const std::string &name) const;
+
+    const Value *column(Size index) const {
+        return columns[index];
+    }
+
+    const std::string &name(Size index) const {
+        return names[index];
+    }
+
+    Size columnCount() const {
+        return columns.size();
+    }
+
+    Size rowCount() const {
+        return rows;
+    }
+
+private:
+
+    void close();
+
+};
+
+#endif //CC_LABS_COLUMN_TABLE_H
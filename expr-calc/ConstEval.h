@@ -0,0 +1,192 @@
+/**
+ * Compile-time evaluation of expressions
+ */
+
+#ifndef CC_LABS_CONST_EVAL_H
+#define CC_LABS_CONST_EVAL_H
+
+#include <climits>
+#include "Calculator.h"
+
+namespace expr_calc {
+
+/**
+ * Reports malformed input; it is not constexpr, so reaching it fails a constant evaluation
+ * and the expression is rejected by the compiler instead of being folded
+ */
+inline void reportConstantError(const char *msg) {
+    std::fprintf(stderr, "constant evaluation error : %s\n", msg);
+}
+
+/**
+ * Lexes, parses and calculates in one pass without building the tree
+ * Follows the grammar and the semantics of Lexer, Parser and Calculator without variables:
+ * spaces are skipped, a missing operand is 0 and trailing symbols are ignored
+ */
+class ConstantParser {
+private:
+    const char *source;
+    Size position = 0;
+    Token token;
+    bool needReadToken = true;
+
+public:
+    constexpr explicit ConstantParser(const char *source) : source(source) {}
+
+    constexpr Value parseExpression() {
+        return parseRelation();
+    }
+
+private:
+
+    static constexpr bool isDigit(Symbol symbol) {
+        return symbol >= '0' && symbol <= '9';
+    }
+
+    static constexpr bool isLetter(Symbol symbol) {
+        return (symbol >= 'a' && symbol <= 'z') || (symbol >= 'A' && symbol <= 'Z') || symbol == '_';
+    }
+
+    /// same tokens as Lexer::nextToken() gives without a variable table
+    constexpr Token nextToken() {
+        while (source[position] == ' ') {
+            ++position;
+        }
+        Symbol symbol = source[position];
+        switch (symbol) {
+            case '>': ++position; return Token::makeOperatorToken(Operator::GREATER_THAN);
+            case '<': ++position; return Token::makeOperatorToken(Operator::LESS_THAN);
+            case '=': ++position; return Token::makeOperatorToken(Operator::EQUAL_TO);
+            case '+': ++position; return Token::makeOperatorToken(Operator::ADDITION);
+            case '-': ++position; return Token::makeOperatorToken(Operator::SUBTRACTION);
+            case '*': ++position; return Token::makeOperatorToken(Operator::MULTIPLICATION);
+            case '/': ++position; return Token::makeOperatorToken(Operator::DIVISION);
+            case '(': ++position; return Token::makeDelimiterToken(Delimiter::PAREN_OPEN);
+            case ')': ++position; return Token::makeDelimiterToken(Delimiter::PAREN_CLOSE);
+            default: break;
+        }
+        if (isLetter(symbol)) {
+            while (isLetter(source[position]) || isDigit(source[position])) {
+                ++position;
+            }
+            return Token();
+        }
+        if (!isDigit(symbol) && symbol != '\0') {
+            ++position;
+            return Token();
+        }
+        // strtol() saturates, the conversion to Value truncates
+        long value = 0;
+        while (isDigit(source[position])) {
+            long digit = source[position++] - '0';
+            value = value > (LONG_MAX - digit) / 10 ? LONG_MAX : value * 10 + digit;
+        }
+        return Token::makeValueToken(static_cast<Value>(value));
+    }
+
+    constexpr const Token &peekToken() {
+        if (needReadToken) {
+            token = nextToken();
+            needReadToken = false;
+        }
+        return token;
+    }
+
+    constexpr void commitToken() {
+        needReadToken = true;
+    }
+
+    constexpr Value parseRelation() {
+        Value left = parseTerm();
+        if (peekToken().type == OPERATOR) {
+            Operator oper = peekToken().oper;
+            if (oper != Operator::EQUAL_TO &&
+                oper != Operator::LESS_THAN &&
+                oper != Operator::GREATER_THAN) {
+                return left;
+            }
+            commitToken();
+            Value right = parseTerm();
+            return applyOperation(left, oper, right);
+        }
+        return left;
+    }
+
+    constexpr Value parseTerm() {
+        Value value = parseFactor();
+        while (peekToken().type == OPERATOR) {
+            Operator oper = peekToken().oper;
+            if (oper != Operator::ADDITION &&
+                oper != Operator::SUBTRACTION) {
+                return value;
+            }
+            commitToken();
+            value = applyOperation(value, oper, parseFactor());
+        }
+        return value;
+    }
+
+    constexpr Value parseFactor() {
+        Value value = parsePrimary();
+        while (peekToken().type == OPERATOR) {
+            Operator oper = peekToken().oper;
+            if (oper != Operator::MULTIPLICATION &&
+                oper != Operator::DIVISION) {
+                return value;
+            }
+            commitToken();
+            Value right = parsePrimary();
+            if (oper == Operator::DIVISION && right == 0) {
+                reportConstantError("VALUE should not be divided by zero");
+                return 0;
+            }
+            value = applyOperation(value, oper, right);
+        }
+        return value;
+    }
+
+    constexpr Value parsePrimary() {
+        if (peekToken().type == DELIMITER && peekToken().delim == Delimiter::PAREN_OPEN) {
+            commitToken();
+            Value value = parseExpression();
+            commitToken();
+            return value;
+        }
+        if (peekToken().type != VALUE) {
+            reportConstantError("expected VALUE type");
+            commitToken();
+            return 0;
+        }
+        Value value = peekToken().value;
+        commitToken();
+        return value;
+    }
+
+};
+
+/**
+ * Evaluates the expression, in a constant expression the result is folded by the compiler
+ *     constexpr Value v = expr_calc::eval("1+(26-98)/15+777<28");
+ * Malformed expressions and division by zero do not compile, signed overflow of +, - and * does not either;
+ * the minimal value divided by -1 wraps around like at run time
+ */
+constexpr Value eval(const char *source) {
+    return ConstantParser(source).parseExpression();
+}
+
+/// forces compile-time evaluation where a constant expression is not required: constant<eval("2*3")>
+template<Value value>
+constexpr Value constant = value;
+
+namespace literals {
+
+/// "1+2*3"_expr is evaluated like eval("1+2*3")
+constexpr Value operator ""_expr(const char *source, Size) {
+    return eval(source);
+}
+
+}
+
+}
+
+#endif //CC_LABS_CONST_EVAL_H
@@ -0,0 +1,38 @@
+/**
+ * Expression pipeline: result cache, parser, compiler and virtual machine
+ */
+
+#include "Evaluator.h"
+#include "profile.h"
+
+template<typename V>
+bool BasicEvaluator<V>::evaluate(const char *source, V &value) {
+    PROFILE_SCOPE("Evaluator::evaluate")
+    if (cache.enabled()) {
+        BasicResultCache<V>::normalize(source, key);
+        if (cache.lookup(key, value)) {
+            return true;
+        }
+    }
+    BasicLexer<V> lexer(source);
+    BasicParser<V> parser(lexer, arena);
+    NodeIndex root = parser.parse();
+    if (parser.hasErrors()) {
+        arena.reset();
+        return false;
+    }
+    BasicCompiler<V>::compile(arena, root, program);
+    arena.reset();
+    if (!vm.run(program, value)) {
+        return false;
+    }
+    if (cache.enabled()) {
+        cache.insert(key, value);
+    }
+    return true;
+}
+
+#define INSTANTIATE_EVALUATOR_TEMPLATES(V) \
+    template class BasicEvaluator<V>;
+
+FOR_EACH_VALUE_TYPE(INSTANTIATE_EVALUATOR_TEMPLATES)
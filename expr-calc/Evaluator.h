@@ -0,0 +1,48 @@
+/**
+ * Expression pipeline: result cache, parser, compiler and virtual machine
+ */
+
+#ifndef CC_LABS_EVALUATOR_H
+#define CC_LABS_EVALUATOR_H
+
+#include "Bytecode.h"
+#include "ResultCache.h"
+
+/**
+ * Evaluates expressions one by one, reusing the arena, program and stack between them
+ * Repeated expressions are answered by the cache without parsing
+ */
+template<typename V>
+class BasicEvaluator {
+private:
+    BasicResultCache<V> cache;
+    BasicNodeArena<V> arena;
+    BasicProgram<V> program;
+    BasicVirtualMachine<V> vm;
+    std::string key;
+
+public:
+
+    /// @param cacheLimit Memory limit of the result cache, 0 to always evaluate
+    explicit BasicEvaluator(Size cacheLimit) : cache(cacheLimit) {}
+
+    /**
+     * @param source Null-terminated expression
+     * @return false, if the expression cannot be parsed or evaluated, such results are not cached
+     */
+    bool evaluate(const char *source, V &value);
+
+    const CacheStats &cacheStats() const {
+        return cache.stats();
+    }
+
+};
+
+typedef BasicEvaluator<Value> Evaluator;
+
+#define EXTERN_EVALUATOR_TEMPLATES(V) \
+    extern template class BasicEvaluator<V>;
+
+FOR_EACH_VALUE_TYPE(EXTERN_EVALUATOR_TEMPLATES)
+
+#endif //CC_LABS_EVALUATOR_H
@@ -0,0 +1,49 @@
+/**
+ * Random valid expressions for benchmarks
+ */
+
+#include <charconv>
+#include "Generator.h"
+
+void ExpressionGenerator::appendLiteral(std::string &expression, uint32_t min) {
+    char digits[16];
+    auto literal = static_cast<uint32_t>(min + random() % (100 - min));
+    expression.append(digits, std::to_chars(digits, digits + sizeof(digits), literal).ptr);
+}
+
+Symbol ExpressionGenerator::drawOperator() {
+    Symbol oper = config.operators[random() % config.operators.size()];
+    if (oper == '<' || oper == '>' || oper == '=') {
+        if (compared.back()) {
+            return '+';
+        }
+        compared.back() = true;
+    }
+    return oper;
+}
+
+void ExpressionGenerator::generate(std::string &expression) {
+    expression.clear();
+    compared.assign(1, false);
+    Symbol oper = '\0';
+    for (Size i = 0; i < config.operands; ++i) {
+        // a parenthesized divisor might be zero
+        if (oper != '/') {
+            while (compared.size() <= config.depth && chance(3)) {
+                expression.push_back('(');
+                compared.push_back(false);
+            }
+        }
+        appendLiteral(expression, oper == '/' ? 1 : 0);
+        if (i + 1 == config.operands) {
+            break;
+        }
+        while (compared.size() > 1 && chance(3)) {
+            expression.push_back(')');
+            compared.pop_back();
+        }
+        oper = drawOperator();
+        expression.push_back(oper);
+    }
+    expression.append(compared.size() - 1, ')');
+}
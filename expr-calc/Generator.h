@@ -0,0 +1,56 @@
+/**
+ * Random valid expressions for benchmarks
+ */
+
+#ifndef CC_LABS_GENERATOR_H
+#define CC_LABS_GENERATOR_H
+
+#include <random>
+#include <string>
+#include <vector>
+#include "Calculator.h"
+
+struct GeneratorConfig {
+    /// operands of an expression
+    Size operands;
+    /// maximal nesting depth of parentheses
+    Size depth;
+    /// operator symbols, each is drawn with equal chance, so repeated symbols are drawn more often
+    std::string operators;
+    uint64_t seed;
+};
+
+/**
+ * Generates expressions which parse and evaluate without errors: a relation has at most one comparison
+ * and divisors are non-zero literals, so there is no division by zero
+ * Parentheses are opened before an operand with chance 1/3 while the depth allows, and closed after it
+ * with the same chance; the generator does not recurse, so any depth can be generated
+ */
+class ExpressionGenerator {
+private:
+    GeneratorConfig config;
+    std::mt19937_64 random;
+    /// per open parenthesis and the top level, true if its relation already has the comparison
+    std::vector<bool> compared;
+
+public:
+    /// the operators should be a non-empty subset of "<>=+-*/"
+    explicit ExpressionGenerator(const GeneratorConfig &config) : config(config), random(config.seed) {}
+
+    /// @param expression Expression to fill, its previous content is dropped
+    void generate(std::string &expression);
+
+private:
+
+    bool chance(uint32_t oneIn) {
+        return random() % oneIn == 0;
+    }
+
+    void appendLiteral(std::string &expression, uint32_t min);
+
+    /// draws an operator of the mix, a second comparison of a relation is replaced by addition
+    Symbol drawOperator();
+
+};
+
+#endif //CC_LABS_GENERATOR_H
@@ -2,12 +2,22 @@
  * Created by ilya on 9/17/19.
  */
 
-#include "Calculator.h"
+#include "Batch.h"
+#include "ColumnEvaluator.h"
+#include "ConstEval.h"
+#include "StreamEvaluator.h"
+
+/// default memory limit of the result cache in line mode
+const Size defaultCacheLimit = 64U << 20U;
+
+/// expression from the lab slides
+constexpr const char demoSource[] = "1+(26-98)/15+777<28";
+
+static_assert(expr_calc::eval(demoSource) == 0, "demo expression is folded at compile time");
 
 char *readTemplate() {
-    auto source = "1+(26-98)/15+777<28";
-    auto result = new char[strlen(source) + 1];
-    strcpy(result, source);
+    auto result = new char[strlen(demoSource) + 1];
+    strcpy(result, demoSource);
     return result;
 }
 
@@ -37,7 +47,88 @@ char *readStdin() {
     return buffer;
 }
 
+/// evaluates the lines in V, if the type is named by ValueTraits<V>::name
+template<typename V>
+static bool evaluateBatchAs(const char *type, FILE *in, const BatchConfig &config, CacheStats &stats) {
+    if (std::strcmp(type, ValueTraits<V>::name) != 0) {
+        return false;
+    }
+    stats = evaluateBatch<V>(in, stdout, config);
+    return true;
+}
+
 int main(int argc, const char **argv) {
+    if (argc > 1 && std::strcmp(argv[1], "--lines") == 0) {
+        BatchConfig config{0, defaultCacheLimit};
+        const char *path = nullptr;
+        const char *type = ValueTraits<Value>::name;
+        for (int i = 2; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--type") == 0 && i + 1 < argc) {
+                type = argv[++i];
+            } else if (std::strcmp(argv[i], "--cache-limit") == 0 && i + 1 < argc) {
+                config.cacheLimit = static_cast<Size>(std::atoll(argv[++i]));
+            } else if (std::strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+                config.threadCount = std::atoi(argv[++i]);
+            } else {
+                path = argv[i];
+            }
+        }
+        FILE *file = path == nullptr ? stdin : std::fopen(path, "rb");
+        if (!file) {
+            std::fprintf(stderr, "Unable to read file %s\n", path);
+            return 127;
+        }
+        CacheStats stats{};
+        bool known = evaluateBatchAs<int>(type, file, config, stats) ||
+                     evaluateBatchAs<int64_t>(type, file, config, stats) ||
+                     evaluateBatchAs<double>(type, file, config, stats) ||
+                     evaluateBatchAs<CheckedInteger>(type, file, config, stats);
+        if (file != stdin) {
+            std::fclose(file);
+        }
+        if (!known) {
+            std::fprintf(stderr, "Unknown type %s, expected int, int64, double or checked\n", type);
+            return 2;
+        }
+        std::fprintf(stderr, "cache: %llu hits, %llu misses, %llu evictions, %zu entries, %zu bytes\n",
+                     (unsigned long long) stats.hits, (unsigned long long) stats.misses,
+                     (unsigned long long) stats.evictions, stats.entries, stats.memory);
+        return 0;
+    }
+    if (argc > 3 && std::strcmp(argv[1], "--columns") == 0) {
+        ColumnTable table;
+        if (!table.open(argv[3])) {
+            return 127;
+        }
+        bool filter = argc > 4 && std::strcmp(argv[4], "--filter") == 0;
+        return evaluateColumns(argv[2], table, filter, stdout) ? 0 : 1;
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--stream") == 0) {
+        FILE *file = argc > 2 ? std::fopen(argv[2], "rb") : stdin;
+        if (!file) {
+            std::fprintf(stderr, "Unable to read file %s\n", argv[2]);
+            return 127;
+        }
+        Value value = 0;
+        Size maxNesting = 0;
+        bool success = evaluateStream(file, value, &maxNesting);
+        if (file != stdin) {
+            std::fclose(file);
+        }
+        if (!success) {
+            return 1;
+        }
+        std::printf("%d\n", value);
+        std::fprintf(stderr, "nesting depth: %zu\n", maxNesting);
+        return 0;
+    }
+    if (argc > 3 && std::strcmp(argv[1], "--pack-columns") == 0) {
+        ColumnTable table;
+        if (!table.readCsv(argv[2])) {
+            return 127;
+        }
+        return table.writeBinary(argv[3]) ? 0 : 1;
+    }
     char *str = nullptr;
     std::printf("Do you want \n"\
     "\tdemo from lab slides (1),\n"\
@@ -77,10 +168,18 @@ int main(int argc, const char **argv) {
 
     std::printf("Processing %s\n", str);
     Lexer lexer(str);
-    Parser parser(lexer);
-    Expression *expr = parser.parse();
+    NodeArena arena;
+    Parser parser(lexer, arena);
+    NodeIndex expr = parser.parse();
     delete[] str;
-    Value value = Calculator::calculate(expr);
+    Program program;
+    Compiler::compile(arena, expr, program);
+    arena.reset();
+    VirtualMachine vm;
+    Value value = 0;
+    if (!vm.run(program, value)) {
+        return 1;
+    }
     std::printf("Result = %d", value);
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,125 @@
+/**
+ * Bounded cache of expression results keyed by the normalized token stream
+ */
+
+#include "ResultCache.h"
+#include "profile.h"
+
+template<typename V>
+size_t BasicResultCache<V>::KeyHash::operator()(const std::string &key) const {
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ key.size();
+    Size i = 0;
+    for (; i + 8 <= key.size(); i += 8) {
+        uint64_t word;
+        std::memcpy(&word, key.data() + i, 8);
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 32U;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, key.data() + i, key.size() - i);
+    hash = (hash ^ tail) * 0xC4CEB9FE1A85EC53ULL;
+    return static_cast<size_t>(hash ^ (hash >> 29U));
+}
+
+template<typename V>
+void BasicResultCache<V>::normalize(const char *source, std::string &key) {
+    PROFILE_SCOPE("ResultCache::normalize")
+    key.clear();
+    BasicLexer<V> lexer(source);
+    lexer.untraceSpaces();
+    while (!lexer.atEnd()) {
+        BasicToken<V> token = lexer.nextToken();
+        key.push_back(static_cast<char>(token.type));
+        switch (token.type) {
+            case OPERATOR: {
+                key.push_back(static_cast<char>(token.oper));
+                break;
+            }
+            case DELIMITER: {
+                key.push_back(static_cast<char>(token.delim));
+                break;
+            }
+            default: {
+                ValueTraits<V>::appendKey(key, token.value);
+                break;
+            }
+        }
+    }
+}
+
+template<typename V>
+Size BasicResultCache<V>::entryCost(Size keySize) {
+    // the key is stored in a node of the index next to the slot number
+    return keySize + sizeof(Entry) + sizeof(std::pair<const std::string, uint32_t>) + 2 * sizeof(void *);
+}
+
+template<typename V>
+bool BasicResultCache<V>::lookup(const std::string &key, V &value) {
+    auto found = index.find(key);
+    if (found == index.end()) {
+        ++cacheStats.misses;
+        return false;
+    }
+    Entry &entry = entries[found->second];
+    entry.referenced = true;
+    value = entry.value;
+    ++cacheStats.hits;
+    return true;
+}
+
+template<typename V>
+void BasicResultCache<V>::evict() {
+    while (true) {
+        if (hand >= entries.size()) {
+            hand = 0;
+        }
+        Entry &entry = entries[hand];
+        if (entry.key != nullptr) {
+            if (!entry.referenced) {
+                cacheStats.memory -= entryCost(entry.key->size());
+                --cacheStats.entries;
+                ++cacheStats.evictions;
+                index.erase(*entry.key);
+                entry.key = nullptr;
+                freeEntries.push_back(static_cast<uint32_t>(hand++));
+                return;
+            }
+            entry.referenced = false;
+        }
+        ++hand;
+    }
+}
+
+template<typename V>
+void BasicResultCache<V>::insert(const std::string &key, V value) {
+    Size cost = entryCost(key.size());
+    if (cost > memoryLimit) {
+        return;
+    }
+    while (cacheStats.memory + cost > memoryLimit) {
+        evict();
+    }
+    auto inserted = index.emplace(key, 0);
+    if (!inserted.second) {
+        entries[inserted.first->second].value = value;
+        return;
+    }
+    uint32_t slot;
+    if (freeEntries.empty()) {
+        slot = static_cast<uint32_t>(entries.size());
+        entries.push_back(Entry{});
+    } else {
+        slot = freeEntries.back();
+        freeEntries.pop_back();
+    }
+    inserted.first->second = slot;
+    entries[slot] = Entry{&inserted.first->first, value, false};
+    cacheStats.memory += cost;
+    ++cacheStats.entries;
+    ++cacheStats.insertions;
+}
+
+#define INSTANTIATE_RESULT_CACHE_TEMPLATES(V) \
+    template class BasicResultCache<V>;
+
+FOR_EACH_VALUE_TYPE(INSTANTIATE_RESULT_CACHE_TEMPLATES)
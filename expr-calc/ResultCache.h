@@ -0,0 +1,91 @@
+/**
+ * Bounded cache of expression results keyed by the normalized token stream
+ */
+
+#ifndef CC_LABS_RESULT_CACHE_H
+#define CC_LABS_RESULT_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Calculator.h"
+
+struct CacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t insertions;
+    uint64_t evictions;
+    Size entries;
+    /// estimated bytes held by the entries
+    Size memory;
+};
+
+/**
+ * Maps normalized expressions to their values, evicting with the CLOCK algorithm
+ * when the memory limit is reached. Not thread-safe, one cache per thread is expected
+ */
+template<typename V>
+class BasicResultCache {
+private:
+
+    struct KeyHash {
+        size_t operator()(const std::string &key) const;
+    };
+
+    struct Entry {
+        /// key owned by the index, nullptr for free slots
+        const std::string *key;
+        V value;
+        bool referenced;
+    };
+
+    Size memoryLimit;
+    std::unordered_map<std::string, uint32_t, KeyHash> index;
+    std::vector<Entry> entries;
+    std::vector<uint32_t> freeEntries;
+    Size hand = 0;
+    CacheStats cacheStats{};
+
+public:
+
+    /// @param memoryLimit Bytes the entries may hold, 0 disables the cache
+    explicit BasicResultCache(Size memoryLimit) : memoryLimit(memoryLimit) {}
+
+    /**
+     * Builds the key of the source: one type byte per token, followed by the operator or delimiter byte
+     * or by the bytes of the value, so spaces and leading zeros do not change it
+     * @param key Key to fill, its previous content is dropped
+     */
+    static void normalize(const char *source, std::string &key);
+
+    /// @return true and the cached value, if the key is present
+    bool lookup(const std::string &key, V &value);
+
+    /// stores the value, evicting entries which were not looked up since the hand passed them
+    void insert(const std::string &key, V value);
+
+    bool enabled() const {
+        return memoryLimit > 0;
+    }
+
+    const CacheStats &stats() const {
+        return cacheStats;
+    }
+
+private:
+
+    static Size entryCost(Size keySize);
+
+    void evict();
+
+};
+
+typedef BasicResultCache<Value> ResultCache;
+
+#define EXTERN_RESULT_CACHE_TEMPLATES(V) \
+    extern template class BasicResultCache<V>;
+
+FOR_EACH_VALUE_TYPE(EXTERN_RESULT_CACHE_TEMPLATES)
+
+#endif //CC_LABS_RESULT_CACHE_H
@@ -0,0 +1,102 @@
+/**
+ * One-pass evaluation of expressions while they are lexed
+ */
+
+#include <memory>
+#include "StreamEvaluator.h"
+#include "profile.h"
+#include "Trace.h"
+
+static inline Value apply(Value left, Operator oper, Value right) {
+    TRACE_START(start);
+    Value result = applyOperation(left, oper, right);
+    TRACE_APPLY(oper, left, right, result, start);
+    return result;
+}
+
+static inline bool isOperator(const Token &token, Operator first, Operator second) {
+    return token.type == OPERATOR && (token.oper == first || token.oper == second);
+}
+
+static inline bool isComparison(const Token &token) {
+    return token.type == OPERATOR && (token.oper == Operator::EQUAL_TO ||
+                                      token.oper == Operator::LESS_THAN ||
+                                      token.oper == Operator::GREATER_THAN);
+}
+
+bool StreamEvaluator::evaluate(Lexer &lexer, Value &result) {
+    PROFILE_SCOPE("StreamEvaluator::evaluate")
+    const Frame emptyFrame{0, OPER_UNKNOWN, 0, OPER_UNKNOWN, 0, OPER_UNKNOWN};
+    frames.assign(1, emptyFrame);
+    Token token = lexer.nextToken();
+    while (true) {
+        // a primary is expected
+        if (token.type == DELIMITER && token.delim == Delimiter::PAREN_OPEN) {
+            frames.push_back(emptyFrame);
+            maxDepth = std::max(maxDepth, frames.size() - 1);
+            token = lexer.nextToken();
+            continue;
+        }
+        if (token.type != VALUE) {
+            char buffer[256];
+            std::snprintf(buffer, sizeof(buffer), "expected VALUE type, got %s", TokenTypeToString(token.type));
+            std::fprintf(stderr, "parsing error : %s\n", buffer);
+        }
+        // like Parser::parseInteger(), a misplaced token is read as 0
+        Value value = token.type == VALUE ? token.value : 0;
+        token = lexer.nextToken();
+
+        // the primary completes the factor, possibly the term and the relation, and then the parenthesis
+        while (true) {
+            Frame &frame = frames.back();
+            if (frame.factorOper == Operator::DIVISION && value == 0) {
+                TRACE_DIVISION_BY_ZERO(frame.factor, 1);
+                StreamEvaluator::reportError("VALUE should not be divided by zero");
+                return false;
+            }
+            frame.factor = frame.factorOper != OPER_UNKNOWN ? apply(frame.factor, frame.factorOper, value)
+                                                            : value;
+            frame.factorOper = OPER_UNKNOWN;
+            if (isOperator(token, Operator::MULTIPLICATION, Operator::DIVISION)) {
+                frame.factorOper = token.oper;
+                break;
+            }
+            frame.term = frame.termOper != OPER_UNKNOWN ? apply(frame.term, frame.termOper, frame.factor)
+                                                        : frame.factor;
+            frame.termOper = OPER_UNKNOWN;
+            if (isOperator(token, Operator::ADDITION, Operator::SUBTRACTION)) {
+                frame.termOper = token.oper;
+                break;
+            }
+            Value relation = frame.term;
+            if (frame.relationOper != OPER_UNKNOWN) {
+                relation = apply(frame.relationLeft, frame.relationOper, frame.term);
+            } else if (isComparison(token)) {
+                frame.relationLeft = frame.term;
+                frame.relationOper = token.oper;
+                break;
+            }
+            if (frames.size() == 1) {
+                result = relation;
+                return true;
+            }
+            frames.pop_back();
+            // like Parser::parsePrimary(), the token after a nested expression is taken for the closing parenthesis
+            token = lexer.nextToken();
+            value = relation;
+        }
+        // the operator is consumed, its right operand follows
+        token = lexer.nextToken();
+    }
+}
+
+bool evaluateStream(FILE *input, Value &value, Size *maxNesting) {
+    std::unique_ptr<Symbol[]> buffer(new Symbol[streamBufferSize]);
+    Lexer lexer(input, buffer.get(), streamBufferSize);
+    StreamEvaluator evaluator;
+    bool success = evaluator.evaluate(lexer, value);
+    if (maxNesting != nullptr) {
+        *maxNesting = evaluator.maxNesting();
+    }
+    return success;
+}
@@ -0,0 +1,63 @@
+/**
+ * One-pass evaluation of expressions while they are lexed
+ */
+
+#ifndef CC_LABS_STREAM_EVALUATOR_H
+#define CC_LABS_STREAM_EVALUATOR_H
+
+#include <vector>
+#include "Calculator.h"
+
+/// stream buffer of the lexer in stream mode
+const Size streamBufferSize = 4U << 20U;
+
+/**
+ * Evaluates left-to-right TERM and FACTOR chains as their operands arrive, without building a tree
+ * Only one frame of partial values per open parenthesis is kept, so memory is O(nesting depth)
+ * instead of O(input size); the results are the same as of Parser and Calculator
+ */
+class StreamEvaluator {
+private:
+
+    /// partial values of an expression, an operator is OPER_UNKNOWN until its left operand is complete
+    struct Frame {
+        Value relationLeft;
+        Operator relationOper;
+        Value term;
+        Operator termOper;
+        Value factor;
+        Operator factorOper;
+    };
+
+    std::vector<Frame> frames;
+    Size maxDepth = 0;
+
+public:
+    StreamEvaluator() = default;
+
+    /**
+     * Evaluates the first expression of the lexer, symbols after it are not read
+     * @return false on division by zero
+     */
+    bool evaluate(Lexer &lexer, Value &value);
+
+    /// deepest nesting of parentheses met so far
+    Size maxNesting() const {
+        return maxDepth;
+    }
+
+private:
+
+    static inline void reportError(const char *msg) {
+        std::fprintf(stderr, "calculation error : %s\n", msg);
+    }
+
+};
+
+/**
+ * Evaluates the expression of the stream, reading it through a large buffer
+ * @return false on division by zero
+ */
+bool evaluateStream(FILE *input, Value &value, Size *maxNesting);
+
+#endif //CC_LABS_STREAM_EVALUATOR_H
@@ -0,0 +1,167 @@
+/**
+ * Evaluation tracing: a ring buffer of recent operations and counters of every operator
+ */
+
+#include "Trace.h"
+
+#ifdef TRACE_ENABLED
+
+#include <charconv>
+#include <cmath>
+#include <mutex>
+#include <vector>
+
+/// Operator values are below this
+const Size traceOperatorCount = DIVISION + 1;
+
+struct TraceCounters {
+    uint64_t count;
+    uint64_t cycles;
+    uint64_t divisionsByZero;
+};
+
+/// trace of one thread
+struct TraceThread {
+    TraceEvent ring[traceRingCapacity];
+    /// count of events ever recorded, the next one is written at written % traceRingCapacity
+    uint64_t written;
+    TraceCounters counters[traceOperatorCount];
+    uint64_t spaces;
+};
+
+std::atomic<bool> traceActive(false);
+
+static std::mutex &traceMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+/// traces of all threads, kept alive until exit
+static std::vector<TraceThread *> &traceThreads() {
+    static std::vector<TraceThread *> threads;
+    return threads;
+}
+
+static TraceThread *traceThread() {
+    static thread_local TraceThread *thread = nullptr;
+    if (thread == nullptr) {
+        thread = new TraceThread();
+        std::lock_guard<std::mutex> lock(traceMutex());
+        traceThreads().push_back(thread);
+    }
+    return thread;
+}
+
+static inline void traceRecord(TraceThread *thread, const TraceEvent &event) {
+    thread->ring[thread->written++ % traceRingCapacity] = event;
+}
+
+void traceSetEnabled(bool enabled) {
+    traceActive.store(enabled, std::memory_order_relaxed);
+}
+
+void traceApply(Operator oper, double left, double right, double result, uint64_t cycles) {
+    TraceThread *thread = traceThread();
+    TraceCounters &counters = thread->counters[oper < traceOperatorCount ? oper : OPER_UNKNOWN];
+    ++counters.count;
+    counters.cycles += cycles;
+    auto eventCycles = static_cast<uint32_t>(std::min<uint64_t>(cycles, UINT32_MAX));
+    traceRecord(thread, TraceEvent{TRACE_APPLY, oper, left, right, result, eventCycles});
+}
+
+void traceKernel(Operator oper, Size rows, uint64_t cycles) {
+    TraceCounters &counters = traceThread()->counters[oper < traceOperatorCount ? oper : OPER_UNKNOWN];
+    counters.count += rows;
+    counters.cycles += cycles;
+}
+
+void traceDivisionByZero(double left, Size count) {
+    TraceThread *thread = traceThread();
+    thread->counters[DIVISION].divisionsByZero += count;
+    traceRecord(thread, TraceEvent{TRACE_DIVISION_BY_ZERO, DIVISION, left, 0, static_cast<double>(count), 0});
+}
+
+void traceSpace() {
+    ++traceThread()->spaces;
+}
+
+/// JSON has no infinities, they are written as strings
+static const char *formatTraceNumber(char *buffer, Size size, double value) {
+    if (std::isfinite(value)) {
+        *std::to_chars(buffer, buffer + size - 1, value).ptr = '\0';
+    } else {
+        std::snprintf(buffer, size, "\"%s\"", std::isnan(value) ? "nan" : value > 0 ? "inf" : "-inf");
+    }
+    return buffer;
+}
+
+void traceDumpJson(FILE *out) {
+    std::lock_guard<std::mutex> lock(traceMutex());
+    TraceCounters total[traceOperatorCount]{};
+    uint64_t spaces = 0;
+    for (const TraceThread *thread : traceThreads()) {
+        for (Size oper = 0; oper < traceOperatorCount; ++oper) {
+            total[oper].count += thread->counters[oper].count;
+            total[oper].cycles += thread->counters[oper].cycles;
+            total[oper].divisionsByZero += thread->counters[oper].divisionsByZero;
+        }
+        spaces += thread->spaces;
+    }
+    std::fprintf(out, "{\n  \"operators\": {");
+    const char *separator = "\n";
+    for (Size oper = 1; oper < traceOperatorCount; ++oper) {
+        std::fprintf(out, "%s    \"%s\": {\"count\": %llu, \"cycles\": %llu, \"division_by_zero\": %llu}",
+                     separator, OperatorToString(static_cast<Operator>(oper)),
+                     (unsigned long long) total[oper].count, (unsigned long long) total[oper].cycles,
+                     (unsigned long long) total[oper].divisionsByZero);
+        separator = ",\n";
+    }
+    std::fprintf(out, "\n  },\n  \"spaces_skipped\": %llu,\n  \"threads\": [", (unsigned long long) spaces);
+    const char *threadSeparator = "\n";
+    for (const TraceThread *thread : traceThreads()) {
+        std::fprintf(out, "%s    {\"events\": [", threadSeparator);
+        uint64_t first = thread->written > traceRingCapacity ? thread->written - traceRingCapacity : 0;
+        for (uint64_t i = first; i < thread->written; ++i) {
+            const TraceEvent &event = thread->ring[i % traceRingCapacity];
+            char left[32], right[32], result[32];
+            std::fprintf(out, "%s\n      {\"kind\": \"%s\", \"operator\": \"%s\", \"left\": %s, \"right\": %s, "
+                              "\"result\": %s, \"cycles\": %u}",
+                         i == first ? "" : ",", event.kind == TRACE_APPLY ? "apply" : "division_by_zero",
+                         OperatorToString(event.oper), formatTraceNumber(left, sizeof(left), event.left),
+                         formatTraceNumber(right, sizeof(right), event.right),
+                         formatTraceNumber(result, sizeof(result), event.result), event.cycles);
+        }
+        std::fprintf(out, "\n    ]}");
+        threadSeparator = ",\n";
+    }
+    std::fprintf(out, "\n  ]\n}\n");
+}
+
+/// switches tracing on by EXPR_TRACE and dumps the trace when static objects are destroyed at exit
+static struct TraceReporter {
+    const char *outPath;
+
+    TraceReporter() : outPath(std::getenv("EXPR_TRACE")) {
+        // construct the registries first, so they are destroyed after the reporter
+        traceMutex();
+        traceThreads();
+        if (outPath != nullptr) {
+            traceSetEnabled(true);
+        }
+    }
+
+    ~TraceReporter() {
+        if (outPath == nullptr) {
+            return;
+        }
+        FILE *out = std::fopen(outPath, "w");
+        if (out == nullptr) {
+            std::fprintf(stderr, "Unable to write trace to %s\n", outPath);
+            return;
+        }
+        traceDumpJson(out);
+        std::fclose(out);
+    }
+} traceReporter;
+
+#endif //TRACE_ENABLED
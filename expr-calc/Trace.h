@@ -0,0 +1,102 @@
+/**
+ * Evaluation tracing: a ring buffer of recent operations and counters of every operator
+ *
+ * Built only with TRACE_ENABLED defined (cmake -DENABLE_TRACE=ON), otherwise the TRACE_ macros expand to nothing.
+ * Such a build traces only while tracing is switched on, either by traceSetEnabled() or by the EXPR_TRACE
+ * environment variable; the latter names the file the counters and the rings are written to as JSON at exit.
+ */
+
+#ifndef CC_LABS_TRACE_H
+#define CC_LABS_TRACE_H
+
+#include "Calculator.h"
+
+#ifdef TRACE_ENABLED
+
+#include <atomic>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <ctime>
+#endif
+
+enum TraceKind : uint8_t {
+    TRACE_APPLY = 0,
+    TRACE_DIVISION_BY_ZERO,
+};
+
+/// values of every numeric type are recorded as double
+struct TraceEvent {
+    TraceKind kind;
+    Operator oper;
+    double left;
+    double right;
+    /// result of TRACE_APPLY, count of zero divisors of TRACE_DIVISION_BY_ZERO
+    double result;
+    uint32_t cycles;
+};
+
+/// events kept by every thread, older ones are overwritten
+const Size traceRingCapacity = 4096;
+
+extern std::atomic<bool> traceActive;
+
+static inline bool traceEnabled() {
+    return traceActive.load(std::memory_order_relaxed);
+}
+
+void traceSetEnabled(bool enabled);
+
+/// returns current value of the cycle counter
+static inline uint64_t traceCycles() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000U + (uint64_t) now.tv_nsec;
+#endif
+}
+
+/// records one application of the operator, cycles include the overhead of the timer
+void traceApply(Operator oper, double left, double right, double result, uint64_t cycles);
+
+/// counts rows of a block evaluated by a column kernel, blocks are not recorded in the ring
+void traceKernel(Operator oper, Size rows, uint64_t cycles);
+
+/// records count divisions of left by zero
+void traceDivisionByZero(double left, Size count);
+
+/// counts a space skipped by the lexer
+void traceSpace();
+
+/// writes the summed counters of all threads and their rings, oldest events first
+void traceDumpJson(FILE *out);
+
+/// starts timing an operation, the variable is used by the other macros
+#define TRACE_START(start) uint64_t start = traceEnabled() ? traceCycles() : 0
+#define TRACE_APPLY(oper, left, right, result, start) \
+    do { \
+        if (traceEnabled()) { \
+            traceApply(oper, valueToDouble(left), valueToDouble(right), valueToDouble(result), \
+                       traceCycles() - (start)); \
+        } \
+    } while (false)
+#define TRACE_KERNEL(oper, rows, start) \
+    do { if (traceEnabled()) { traceKernel(oper, rows, traceCycles() - (start)); } } while (false)
+#define TRACE_DIVISION_BY_ZERO(left, count) \
+    do { if (traceEnabled()) { traceDivisionByZero(valueToDouble(left), count); } } while (false)
+#define TRACE_SPACE() \
+    do { if (traceEnabled()) { traceSpace(); } } while (false)
+
+#else
+
+#define TRACE_START(start)
+#define TRACE_APPLY(oper, left, right, result, start)
+#define TRACE_KERNEL(oper, rows, start)
+#define TRACE_DIVISION_BY_ZERO(left, count)
+#define TRACE_SPACE()
+
+#endif //TRACE_ENABLED
+
+#endif //CC_LABS_TRACE_H
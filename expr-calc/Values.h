@@ -0,0 +1,243 @@
+/**
+ * Numeric types of the calculator and their traits
+ */
+
+#ifndef CC_LABS_VALUES_H
+#define CC_LABS_VALUES_H
+
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+typedef size_t Size;
+typedef char Symbol;
+/// default numeric type, the engines are instantiated for every type of FOR_EACH_VALUE_TYPE
+typedef int Value;
+
+/**
+ * 64-bit integer which detects overflow with the compiler builtins
+ * An overflowing operation sets the flag instead of wrapping around, the engines check it after every operation
+ */
+class CheckedInteger {
+private:
+    int64_t number;
+    bool overflowed;
+
+    constexpr CheckedInteger(int64_t number, bool overflowed) : number(number), overflowed(overflowed) {}
+
+public:
+    /// trivial, so values can be members of unions
+    CheckedInteger() = default;
+
+    constexpr CheckedInteger(int64_t number) : number(number), overflowed(false) {}
+
+    static constexpr CheckedInteger makeOverflowed() {
+        return CheckedInteger(0, true);
+    }
+
+    constexpr int64_t get() const {
+        return number;
+    }
+
+    constexpr bool overflow() const {
+        return overflowed;
+    }
+
+    friend constexpr CheckedInteger operator+(CheckedInteger x, CheckedInteger y) {
+        int64_t result = 0;
+        bool overflow = __builtin_add_overflow(x.number, y.number, &result);
+        return CheckedInteger(result, overflow || x.overflowed || y.overflowed);
+    }
+
+    friend constexpr CheckedInteger operator-(CheckedInteger x, CheckedInteger y) {
+        int64_t result = 0;
+        bool overflow = __builtin_sub_overflow(x.number, y.number, &result);
+        return CheckedInteger(result, overflow || x.overflowed || y.overflowed);
+    }
+
+    friend constexpr CheckedInteger operator*(CheckedInteger x, CheckedInteger y) {
+        int64_t result = 0;
+        bool overflow = __builtin_mul_overflow(x.number, y.number, &result);
+        return CheckedInteger(result, overflow || x.overflowed || y.overflowed);
+    }
+
+    /// the divisor should not be zero, the minimal value divided by -1 overflows
+    friend constexpr CheckedInteger operator/(CheckedInteger x, CheckedInteger y) {
+        if (x.number == INT64_MIN && y.number == -1) {
+            return makeOverflowed();
+        }
+        return CheckedInteger(x.number / y.number, x.overflowed || y.overflowed);
+    }
+
+    friend constexpr bool operator>(CheckedInteger x, CheckedInteger y) {
+        return x.number > y.number;
+    }
+
+    friend constexpr bool operator<(CheckedInteger x, CheckedInteger y) {
+        return x.number < y.number;
+    }
+
+    friend constexpr bool operator==(CheckedInteger x, CheckedInteger y) {
+        return x.number == y.number;
+    }
+
+    friend constexpr bool operator!=(CheckedInteger x, CheckedInteger y) {
+        return x.number != y.number;
+    }
+};
+
+/**
+ * Conversions and arithmetic of a numeric type, specialized for every supported type
+ * parse() converts digits of a literal, format() writes at most formatLength symbols,
+ * isValid() is false for values which overflowed a checked type
+ */
+template<typename V>
+struct ValueTraits;
+
+template<>
+struct ValueTraits<int> {
+    static constexpr const char *name = "int";
+    static const Size formatLength = 11;
+
+    /// strtol() saturates, the conversion truncates
+    static int parse(const char *digits) {
+        return static_cast<int>(std::strtol(digits, nullptr, 10));
+    }
+
+    static constexpr bool isValid(int) {
+        return true;
+    }
+
+    /// the divisor should not be zero, the minimal value divided by -1 wraps around instead of trapping
+    static constexpr int divide(int dividend, int divisor) {
+        return divisor == -1 ? static_cast<int>(0U - static_cast<unsigned>(dividend)) : dividend / divisor;
+    }
+
+    static char *format(char *out, int value) {
+        return std::to_chars(out, out + formatLength, value).ptr;
+    }
+
+    static constexpr double toDouble(int value) {
+        return value;
+    }
+
+    static void appendKey(std::string &key, int value) {
+        key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+};
+
+template<>
+struct ValueTraits<int64_t> {
+    static constexpr const char *name = "int64";
+    static const Size formatLength = 20;
+
+    /// strtoll() saturates
+    static int64_t parse(const char *digits) {
+        return static_cast<int64_t>(std::strtoll(digits, nullptr, 10));
+    }
+
+    static constexpr bool isValid(int64_t) {
+        return true;
+    }
+
+    /// the divisor should not be zero, the minimal value divided by -1 wraps around instead of trapping
+    static constexpr int64_t divide(int64_t dividend, int64_t divisor) {
+        return divisor == -1 ? static_cast<int64_t>(0U - static_cast<uint64_t>(dividend)) : dividend / divisor;
+    }
+
+    static char *format(char *out, int64_t value) {
+        return std::to_chars(out, out + formatLength, value).ptr;
+    }
+
+    static constexpr double toDouble(int64_t value) {
+        return static_cast<double>(value);
+    }
+
+    static void appendKey(std::string &key, int64_t value) {
+        key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+};
+
+template<>
+struct ValueTraits<double> {
+    static constexpr const char *name = "double";
+    /// shortest representation, that is read back to the same value
+    static const Size formatLength = 24;
+
+    static double parse(const char *digits) {
+        return std::strtod(digits, nullptr);
+    }
+
+    static constexpr bool isValid(double) {
+        return true;
+    }
+
+    static constexpr double divide(double dividend, double divisor) {
+        return dividend / divisor;
+    }
+
+    static char *format(char *out, double value) {
+        return std::to_chars(out, out + formatLength, value).ptr;
+    }
+
+    static constexpr double toDouble(double value) {
+        return value;
+    }
+
+    static void appendKey(std::string &key, double value) {
+        key.append(reinterpret_cast<const char *>(&value), sizeof(value));
+    }
+};
+
+template<>
+struct ValueTraits<CheckedInteger> {
+    static constexpr const char *name = "checked";
+    static const Size formatLength = 20;
+
+    /// literals beyond 64 bits overflow
+    static CheckedInteger parse(const char *digits) {
+        errno = 0;
+        long long number = std::strtoll(digits, nullptr, 10);
+        return errno == ERANGE ? CheckedInteger::makeOverflowed() : CheckedInteger(static_cast<int64_t>(number));
+    }
+
+    static constexpr bool isValid(CheckedInteger value) {
+        return !value.overflow();
+    }
+
+    static constexpr CheckedInteger divide(CheckedInteger dividend, CheckedInteger divisor) {
+        return dividend / divisor;
+    }
+
+    static char *format(char *out, CheckedInteger value) {
+        return std::to_chars(out, out + formatLength, value.get()).ptr;
+    }
+
+    static constexpr double toDouble(CheckedInteger value) {
+        return static_cast<double>(value.get());
+    }
+
+    static void appendKey(std::string &key, CheckedInteger value) {
+        int64_t number = value.get();
+        key.append(reinterpret_cast<const char *>(&number), sizeof(number));
+        key.push_back(value.overflow() ? 1 : 0);
+    }
+};
+
+/// converts any supported value for reports, precision of large integers may be lost
+template<typename V>
+constexpr double valueToDouble(V value) {
+    return ValueTraits<V>::toDouble(value);
+}
+
+/// applies the macro to every supported numeric type, used for explicit instantiations
+#define FOR_EACH_VALUE_TYPE(MACRO) \
+    MACRO(int) \
+    MACRO(int64_t) \
+    MACRO(double) \
+    MACRO(CheckedInteger)
+
+#endif //CC_LABS_VALUES_H
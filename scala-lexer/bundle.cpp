@@ -0,0 +1,185 @@
+//
+// Packed bundle of source files, lexed from a single mapping
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+#include "bundle.h"
+#include "files.h"
+
+static inline uint64_t align8(uint64_t value) {
+    return (value + 7U) & ~(uint64_t) 7U;
+}
+
+int bundle_pack(const char *bundle_path, const char **roots, int root_count) {
+    std::vector<std::string> paths;
+    for (int i = 0; i < root_count; ++i) {
+        collect_source_files(roots[i], paths);
+    }
+    std::sort(paths.begin(), paths.end());
+
+    // directory is written first, so the files are mapped twice instead of keeping them all
+    std::vector<bundle_entry_t> entries;
+    std::vector<char> strings;
+    uint64_t contents_size = 0;
+    for (auto &path : paths) {
+        mapped_file_t file{};
+        if (!map_file(path.c_str(), &file)) {
+            // empty or unreadable files have nothing to lex
+            continue;
+        }
+        bundle_entry_t entry{};
+        entry.path_offset = (uint32_t) strings.size();
+        entry.path_length = (uint32_t) path.size();
+        entry.offset = contents_size;
+        entry.length = file.size;
+        entry.hash = hash_content(file.data, file.size);
+        strings.insert(strings.end(), path.begin(), path.end());
+        strings.push_back('\0');
+        contents_size += file.size;
+        entries.push_back(entry);
+        unmap_file(&file);
+    }
+
+    bundle_header_t header{};
+    header.magic = BUNDLE_MAGIC;
+    header.version = BUNDLE_VERSION;
+    header.entry_count = (uint32_t) entries.size();
+    header.entries_offset = align8(sizeof(bundle_header_t));
+    header.strings_offset = align8(header.entries_offset + sizeof(bundle_entry_t) * entries.size());
+    header.contents_offset = align8(header.strings_offset + strings.size());
+
+    FILE *out = fopen(bundle_path, "wb");
+    if (out == nullptr) {
+        fprintf(stderr, "Unable to write bundle %s\n", bundle_path);
+        return -1;
+    }
+    static const uint8_t padding[8] = {0};
+    uint64_t written = 0;
+    auto write_section = [&](uint64_t offset, const void *data, size_t size) {
+        fwrite(padding, 1, offset - written, out);
+        fwrite(data, 1, size, out);
+        written = offset + size;
+    };
+    write_section(0, &header, sizeof(header));
+    write_section(header.entries_offset, entries.data(), sizeof(bundle_entry_t) * entries.size());
+    write_section(header.strings_offset, strings.data(), strings.size());
+    bool failed = false;
+    for (auto &entry : entries) {
+        mapped_file_t file{};
+        const char *path = strings.data() + entry.path_offset;
+        if (!map_file(path, &file) || file.size != entry.length) {
+            fprintf(stderr, "File %s changed while packing\n", path);
+            unmap_file(&file);
+            failed = true;
+            break;
+        }
+        write_section(header.contents_offset + entry.offset, file.data, file.size);
+        unmap_file(&file);
+    }
+    failed |= ferror(out) != 0;
+    failed |= fclose(out) != 0;
+    if (failed) {
+        fprintf(stderr, "Unable to write bundle %s\n", bundle_path);
+        return -1;
+    }
+    return (int) entries.size();
+}
+
+int bundle_open(bundle_t *bundle, const char *bundle_path) {
+    mapped_file_t file{};
+    if (!map_file(bundle_path, &file)) {
+        return -1;
+    }
+    bundle->data = (const uint8_t *) file.data;
+    bundle->size = file.size;
+    bundle->header = (const bundle_header_t *) bundle->data;
+    const bundle_header_t *header = bundle->header;
+    if (file.size < sizeof(bundle_header_t) ||
+        header->magic != BUNDLE_MAGIC || header->version != BUNDLE_VERSION ||
+        header->contents_offset > file.size ||
+        header->entries_offset + sizeof(bundle_entry_t) * header->entry_count > header->strings_offset) {
+        unmap_file(&file);
+        return -1;
+    }
+    bundle->entries = (const bundle_entry_t *) (bundle->data + header->entries_offset);
+    bundle->strings = (const char *) (bundle->data + header->strings_offset);
+    bundle->contents = (const symbol_t *) (bundle->data + header->contents_offset);
+    size_t contents_size = file.size - header->contents_offset;
+    for (uint32_t i = 0; i < header->entry_count; ++i) {
+        const bundle_entry_t &entry = bundle->entries[i];
+        if (entry.offset > contents_size || entry.length > contents_size - entry.offset) {
+            unmap_file(&file);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void bundle_close(bundle_t *bundle) {
+    mapped_file_t file{(const symbol_t *) bundle->data, bundle->size};
+    unmap_file(&file);
+    bundle->data = nullptr;
+    bundle->size = 0;
+}
+
+const char *bundle_entry_path(const bundle_t *bundle, uint32_t entry_id) {
+    if (entry_id >= bundle->header->entry_count) {
+        return nullptr;
+    }
+    return bundle->strings + bundle->entries[entry_id].path_offset;
+}
+
+const symbol_t *bundle_entry_data(const bundle_t *bundle, uint32_t entry_id) {
+    if (entry_id >= bundle->header->entry_count) {
+        return nullptr;
+    }
+    return bundle->contents + bundle->entries[entry_id].offset;
+}
+
+/// lexes one entry, payloads are not built since only the tokens are counted
+static size_t lex_entry(const bundle_t *bundle, uint32_t entry_id) {
+    lex_reset();
+    lex_input_buffer(bundle_entry_data(bundle, entry_id), bundle->entries[entry_id].length);
+    size_t token_count = 0;
+    token_t token;
+    while (true) {
+        token = lex_next_policy<lex_kinds_policy_t>();
+        if (token.type == TOKEN_EOF) {
+            break;
+        }
+        ++token_count;
+    }
+    return token_count;
+}
+
+size_t bundle_lex(const bundle_t *bundle, int thread_count, FILE *out) {
+    uint32_t entry_count = bundle->header->entry_count;
+    if (thread_count <= 0) {
+        thread_count = (int) std::max(1U, std::thread::hardware_concurrency());
+    }
+    std::vector<size_t> token_counts(entry_count);
+    std::vector<std::thread> threads;
+    std::atomic<uint32_t> next_entry(0);
+    for (int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&]() {
+            uint32_t entry_id;
+            while ((entry_id = next_entry.fetch_add(1)) < entry_count) {
+                token_counts[entry_id] = lex_entry(bundle, entry_id);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    size_t total = 0;
+    for (uint32_t i = 0; i < entry_count; ++i) {
+        fprintf(out, "%s %zu\n", bundle_entry_path(bundle, i), token_counts[i]);
+        total += token_counts[i];
+    }
+    return total;
+}
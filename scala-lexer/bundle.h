@@ -0,0 +1,87 @@
+//
+// Packed bundle of source files, lexed from a single mapping
+//
+
+#ifndef CC_LABS_BUNDLE_H
+#define CC_LABS_BUNDLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include "lexer.h"
+
+/// "SCBN" in little-endian
+#define BUNDLE_MAGIC        0x4e424353U
+#define BUNDLE_VERSION      1U
+
+/**
+ * Bundle file header
+ * The file is laid out as follows, all integers are little-endian, sections are 8-byte aligned:
+ *   bundle_header_t
+ *   bundle_entry_t entries[entry_count]     - sorted by path
+ *   string table                            - null-terminated paths
+ *   contents                                - concatenated file contents
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t entry_count;
+    uint32_t reserved;
+    uint64_t entries_offset;
+    uint64_t strings_offset;
+    uint64_t contents_offset;
+} bundle_header_t;
+
+/// Directory entry of one source file
+typedef struct {
+    /// path position in the string table
+    uint32_t path_offset;
+    uint32_t path_length;
+    /// content position relative to the contents section
+    uint64_t offset;
+    uint64_t length;
+    /// hash_content() of the content
+    uint64_t hash;
+} bundle_entry_t;
+
+/// Bundle file mapped into memory
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    const bundle_header_t *header;
+    const bundle_entry_t *entries;
+    const char *strings;
+    const symbol_t *contents;
+} bundle_t;
+
+/**
+ * Packs all .scala files under the roots into the bundle
+ * @param bundle_path Path of the bundle file to write
+ * @param roots Files or directories to pack
+ * @param root_count Count of roots
+ * @return count of packed files, -1 if the bundle cannot be written
+ */
+int bundle_pack(const char *bundle_path, const char **roots, int root_count);
+
+/**
+ * Maps the bundle file into memory
+ * @return 0 on success, -1 if the file is missing or is not a valid bundle
+ */
+int bundle_open(bundle_t *bundle, const char *bundle_path);
+
+void bundle_close(bundle_t *bundle);
+
+/// returns null-terminated path of the entry
+const char *bundle_entry_path(const bundle_t *bundle, uint32_t entry_id);
+
+/// returns content of the entry, which is not null-terminated
+const symbol_t *bundle_entry_data(const bundle_t *bundle, uint32_t entry_id);
+
+/**
+ * Lexes all entries of the bundle in parallel and prints token count of every entry
+ * @param thread_count Count of lexing threads, 0 to use all cores
+ * @return total count of tokens
+ */
+size_t bundle_lex(const bundle_t *bundle, int thread_count, FILE *out);
+
+#endif //CC_LABS_BUNDLE_H
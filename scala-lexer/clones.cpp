@@ -0,0 +1,230 @@
+//
+// Token-stream fingerprinting for clone detection
+//
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include "clones.h"
+#include "files.h"
+#include "lexer.h"
+
+/// multiplier of the rolling polynomial hash
+#define CLONES_HASH_BASE 0x100000001b3ULL
+
+/// place where the fingerprint was seen first
+typedef struct {
+    uint32_t file_id;
+    int first_line;
+    int last_line;
+} fingerprint_location_t;
+
+/// window hash candidate for winnowing
+typedef struct {
+    uint64_t hash;
+    size_t index;
+    int first_line;
+    int last_line;
+} window_hash_t;
+
+/// duplicate region being extended while matches keep coming
+typedef struct {
+    bool active;
+    uint32_t original_file_id;
+    int original_first_line;
+    int original_last_line;
+    int first_line;
+    int last_line;
+} clone_region_t;
+
+/// corpus-wide fingerprint table, bounded by the config
+typedef struct {
+    const clones_config_t *config;
+    const std::vector<std::string> *paths;
+    std::unordered_map<uint64_t, fingerprint_location_t> fingerprints;
+    /// only fingerprints with this many low zero bits are kept
+    uint32_t sample_bits;
+    size_t reported;
+    FILE *out;
+} clones_state_t;
+
+static inline uint64_t mix_code(uint64_t code) {
+    code ^= code >> 31U;
+    code *= 0x7fb5d329728ea185ULL;
+    code ^= code >> 27U;
+    code *= 0x81dadef4bc2dd44dULL;
+    code ^= code >> 33U;
+    return code;
+}
+
+/**
+ * Reduces the token to its type and keyword, operator or delimiter code
+ * @return normalized token code, 0 if the token should not be compared at all
+ */
+static inline uint64_t normalize_token(const token_t *token) {
+    uint32_t code = 0;
+    switch (token->type) {
+        case TOKEN_KEYWORD: code = token->keyword; break;
+        case TOKEN_IDENTIFIER: code = token->oper; break;
+        case TOKEN_UNKNOWN: code = token->char_value; break;
+        case TOKEN_DELIMITER: {
+            if (token->delim == DELIM_NEWLINE) {
+                // layout does not matter
+                return 0;
+            }
+            code = token->delim;
+            break;
+        }
+        default: break;
+    }
+    return mix_code(((uint64_t) token->type << 32U) | code);
+}
+
+static inline bool is_sampled(const clones_state_t *state, uint64_t hash) {
+    return (hash & ((1ULL << state->sample_bits) - 1U)) == 0;
+}
+
+/// makes sampling twice sparser and drops fingerprints which do not pass it anymore
+static void thin_fingerprints(clones_state_t *state) {
+    ++state->sample_bits;
+    for (auto it = state->fingerprints.begin(); it != state->fingerprints.end();) {
+        if (is_sampled(state, it->first)) {
+            ++it;
+        } else {
+            it = state->fingerprints.erase(it);
+        }
+    }
+}
+
+static void flush_region(clones_state_t *state, uint32_t file_id, clone_region_t *region) {
+    if (!region->active) {
+        return;
+    }
+    fprintf(state->out, "%s:%d-%d %s:%d-%d\n",
+            (*state->paths)[file_id].c_str(), region->first_line, region->last_line,
+            (*state->paths)[region->original_file_id].c_str(),
+            region->original_first_line, region->original_last_line);
+    ++state->reported;
+    region->active = false;
+}
+
+static void add_fingerprint(clones_state_t *state, uint32_t file_id, const window_hash_t *window,
+                            clone_region_t *region) {
+    if (!is_sampled(state, window->hash)) {
+        return;
+    }
+    auto found = state->fingerprints.find(window->hash);
+    if (found == state->fingerprints.end()) {
+        fingerprint_location_t location{file_id, window->first_line, window->last_line};
+        state->fingerprints.emplace(window->hash, location);
+        if (state->fingerprints.size() > state->config->max_fingerprints) {
+            thin_fingerprints(state);
+        }
+        return;
+    }
+    const fingerprint_location_t &original = found->second;
+    if (original.file_id == file_id && original.last_line >= window->first_line) {
+        // overlapping window of the same file
+        return;
+    }
+    if (region->active && region->original_file_id == original.file_id &&
+        window->first_line <= region->last_line + 1) {
+        region->last_line = std::max(region->last_line, window->last_line);
+        region->original_first_line = std::min(region->original_first_line, original.first_line);
+        region->original_last_line = std::max(region->original_last_line, original.last_line);
+        return;
+    }
+    flush_region(state, file_id, region);
+    region->active = true;
+    region->original_file_id = original.file_id;
+    region->original_first_line = original.first_line;
+    region->original_last_line = original.last_line;
+    region->first_line = window->first_line;
+    region->last_line = window->last_line;
+}
+
+static void fingerprint_file(clones_state_t *state, uint32_t file_id) {
+    mapped_file_t file{};
+    if (!map_file((*state->paths)[file_id].c_str(), &file)) {
+        return;
+    }
+    lex_reset();
+    lex_set_lazy_payload(1);
+    lex_input_buffer(file.data, file.size);
+
+    const size_t k = state->config->window_tokens;
+    const size_t w = state->config->winnow_size;
+    uint64_t base_power = 1;
+    for (size_t i = 1; i < k; ++i) {
+        base_power *= CLONES_HASH_BASE;
+    }
+    std::vector<uint64_t> codes(k);
+    std::vector<int> lines(k);
+    std::vector<window_hash_t> windows(w);
+    uint64_t hash = 0;
+    size_t token_count = 0;
+    size_t window_count = 0;
+    size_t selected = SIZE_MAX;
+    clone_region_t region{};
+
+    token_t token;
+    while (true) {
+        token = lex_next();
+        if (token.type == TOKEN_EOF) {
+            break;
+        }
+        uint64_t code = normalize_token(&token);
+        if (code == 0) {
+            continue;
+        }
+        size_t slot = token_count % k;
+        if (token_count >= k) {
+            hash -= codes[slot] * base_power;
+        }
+        hash = hash * CLONES_HASH_BASE + code;
+        codes[slot] = code;
+        lines[slot] = token.line;
+        ++token_count;
+        if (token_count < k) {
+            continue;
+        }
+        // window of the last k tokens is complete
+        window_hash_t &window = windows[window_count % w];
+        window.hash = hash;
+        window.index = window_count;
+        window.first_line = lines[token_count % k];
+        window.last_line = token.line;
+        ++window_count;
+        if (window_count < w) {
+            continue;
+        }
+        // winnowing: select the rightmost minimal hash among the last w windows
+        const window_hash_t *minimal = &windows[0];
+        for (auto &candidate : windows) {
+            if (candidate.hash < minimal->hash ||
+                (candidate.hash == minimal->hash && candidate.index > minimal->index)) {
+                minimal = &candidate;
+            }
+        }
+        if (minimal->index != selected) {
+            selected = minimal->index;
+            add_fingerprint(state, file_id, minimal, &region);
+        }
+    }
+    flush_region(state, file_id, &region);
+    lex_set_lazy_payload(0);
+    unmap_file(&file);
+}
+
+size_t clones_report(const std::vector<std::string> &paths, const clones_config_t *config, FILE *out) {
+    clones_state_t state{};
+    state.config = config;
+    state.paths = &paths;
+    state.sample_bits = 0;
+    state.reported = 0;
+    state.out = out;
+    for (uint32_t file_id = 0; file_id < paths.size(); ++file_id) {
+        fingerprint_file(&state, file_id);
+    }
+    return state.reported;
+}
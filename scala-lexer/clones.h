@@ -0,0 +1,38 @@
+//
+// Token-stream fingerprinting for clone detection
+//
+
+#ifndef CC_LABS_CLONES_H
+#define CC_LABS_CLONES_H
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/// Clone detection settings
+typedef struct {
+    /// count of normalized tokens hashed together
+    size_t window_tokens;
+    /// count of consecutive window hashes a fingerprint is selected from (winnowing)
+    size_t winnow_size;
+    /// limit of remembered fingerprints, sampling gets sparser when it is reached
+    size_t max_fingerprints;
+} clones_config_t;
+
+#define CLONES_DEFAULT_WINDOW_TOKENS     32
+#define CLONES_DEFAULT_WINNOW_SIZE       8
+#define CLONES_DEFAULT_MAX_FINGERPRINTS  (1U << 22U)
+
+/**
+ * Lexes files one by one in a single pass and reports regions of duplicate code
+ * Identifiers and literals are abstracted away, so only token types, keywords, operators and delimiters are compared
+ * Each reported line is "<clone file>:<first line>-<last line> <original file>:<first line>-<last line>"
+ * @param paths Files to check, earlier files are treated as originals
+ * @param config Detection settings
+ * @param out Report stream
+ * @return count of reported regions
+ */
+size_t clones_report(const std::vector<std::string> &paths, const clones_config_t *config, FILE *out);
+
+#endif //CC_LABS_CLONES_H
@@ -0,0 +1,175 @@
+//
+// Line and token statistics of Scala source trees
+//
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <thread>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "count.h"
+#include "files.h"
+
+/// line flags of count_source()
+#define LINE_COMMENT    0x01U
+#define LINE_CODE       0x02U
+
+/// positions and trivia, no payloads are needed to classify lines
+typedef lex_policy_t<true, true, false, false> lex_count_policy_t;
+
+uint64_t count_newlines(const symbol_t *data, size_t size) {
+    uint64_t count = 0;
+    size_t i = 0;
+#if defined(__AVX2__)
+    const __m256i newline = _mm256_set1_epi8('\n');
+    for (; i + 32 <= size; i += 32) {
+        __m256i chunk = _mm256_loadu_si256((const __m256i *) (data + i));
+        auto mask = (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline));
+        count += (uint64_t) __builtin_popcount(mask);
+    }
+#elif defined(__SSE2__)
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= size; i += 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i *) (data + i));
+        auto mask = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+        count += (uint64_t) __builtin_popcount(mask);
+    }
+#endif
+    for (; i < size; ++i) {
+        count += data[i] == '\n';
+    }
+    return count;
+}
+
+/// flags lines from first to last, both are 1-based
+static inline void mark_lines(std::vector<uint8_t> &lines, uint64_t first, uint64_t last, uint8_t flag) {
+    last = std::min(last, (uint64_t) lines.size() - 1);
+    for (uint64_t line = first; line <= last; ++line) {
+        lines[line] |= flag;
+    }
+}
+
+void count_source(const symbol_t *data, size_t size, count_stats_t *stats) {
+    ++stats->files;
+    if (size == 0) {
+        return;
+    }
+    uint64_t physical_lines = count_newlines(data, size) + (data[size - 1] != '\n' ? 1 : 0);
+    stats->lines += physical_lines;
+    std::vector<uint8_t> lines(physical_lines + 1);
+
+    lex_reset();
+    lex_input_buffer(data, size);
+    // a token ends on the line where the next one starts, so the classification is one token behind
+    token_t previous{};
+    uint8_t previous_flag = 0;
+    while (true) {
+        token_t token = lex_next_policy<lex_count_policy_t>();
+        if (previous_flag != 0) {
+            mark_lines(lines, previous.line, std::max(token.line, previous.line), previous_flag);
+        }
+        if (token.type == TOKEN_EOF) {
+            break;
+        }
+        previous = token;
+        previous_flag = 0;
+        if (token.type == TOKEN_COMMENT) {
+            previous_flag = LINE_COMMENT;
+        } else if (token.type == TOKEN_WHITESPACE ||
+                   (token.type == TOKEN_DELIMITER && token.delim == DELIM_NEWLINE && data[token.pos] == '\n')) {
+            continue;
+        } else {
+            previous_flag = LINE_CODE;
+            ++stats->tokens;
+        }
+    }
+
+    for (uint64_t line = 1; line < lines.size(); ++line) {
+        if (lines[line] & LINE_CODE) {
+            ++stats->code_lines;
+        } else if (lines[line] & LINE_COMMENT) {
+            ++stats->comment_lines;
+        } else {
+            ++stats->blank_lines;
+        }
+    }
+}
+
+static void add_stats(count_stats_t *target, const count_stats_t *stats) {
+    target->files += stats->files;
+    target->lines += stats->lines;
+    target->blank_lines += stats->blank_lines;
+    target->comment_lines += stats->comment_lines;
+    target->code_lines += stats->code_lines;
+    target->tokens += stats->tokens;
+}
+
+static void print_stats(FILE *out, const count_stats_t *stats, const char *name) {
+    fprintf(out, "%8llu %10llu %10llu %10llu %10llu %12llu  %s\n",
+            (unsigned long long) stats->files, (unsigned long long) stats->lines,
+            (unsigned long long) stats->blank_lines, (unsigned long long) stats->comment_lines,
+            (unsigned long long) stats->code_lines, (unsigned long long) stats->tokens, name);
+}
+
+/// returns true, if the directory is one of the roots or is under one of them
+static bool is_under_roots(const std::vector<std::string> &roots, const std::string &directory) {
+    for (auto &root : roots) {
+        if (directory.compare(0, root.size(), root) == 0 &&
+            (directory.size() == root.size() || directory[root.size()] == '/')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+count_stats_t count_report(const std::vector<std::string> &roots, const std::vector<std::string> &paths,
+                           int thread_count, FILE *out) {
+    if (thread_count <= 0) {
+        thread_count = (int) std::max(1U, std::thread::hardware_concurrency());
+    }
+    std::vector<count_stats_t> file_stats(paths.size(), count_stats_t{});
+    std::vector<std::thread> threads;
+    std::atomic<size_t> next_file(0);
+    for (int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&]() {
+            size_t file_id;
+            while ((file_id = next_file.fetch_add(1)) < paths.size()) {
+                mapped_file_t file{};
+                if (map_file(paths[file_id].c_str(), &file)) {
+                    count_source(file.data, file.size, &file_stats[file_id]);
+                    unmap_file(&file);
+                } else {
+                    // empty files are not mapped
+                    file_stats[file_id].files = 1;
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    fprintf(out, "%8s %10s %10s %10s %10s %12s  %s\n", "files", "lines", "blank", "comment", "code", "tokens",
+            "path");
+    std::map<std::string, count_stats_t> directories;
+    count_stats_t total{};
+    for (size_t i = 0; i < paths.size(); ++i) {
+        print_stats(out, &file_stats[i], paths[i].c_str());
+        add_stats(&total, &file_stats[i]);
+        for (size_t slash = paths[i].rfind('/'); slash != std::string::npos && slash > 0;
+             slash = paths[i].rfind('/', slash - 1)) {
+            std::string directory = paths[i].substr(0, slash);
+            if (!is_under_roots(roots, directory)) {
+                break;
+            }
+            add_stats(&directories[directory], &file_stats[i]);
+        }
+    }
+    for (auto &directory : directories) {
+        print_stats(out, &directory.second, (directory.first + "/").c_str());
+    }
+    print_stats(out, &total, "total");
+    return total;
+}
@@ -0,0 +1,51 @@
+//
+// Line and token statistics of Scala source trees
+//
+
+#ifndef CC_LABS_COUNT_H
+#define CC_LABS_COUNT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "lexer.h"
+
+/**
+ * Line counts of a file or a directory
+ * Each physical line is either blank, comment or code; lines with both code and comments are code lines
+ */
+typedef struct {
+    uint64_t files;
+    uint64_t lines;
+    uint64_t blank_lines;
+    uint64_t comment_lines;
+    uint64_t code_lines;
+    /// tokens except whitespaces, comments and newlines
+    uint64_t tokens;
+} count_stats_t;
+
+/**
+ * Counts newline symbols with vector instructions, if they are available
+ * @return count of '\n' in the data
+ */
+uint64_t count_newlines(const symbol_t *data, size_t size);
+
+/**
+ * Lexes the source with the trivia lexer core and classifies its lines
+ * Comment markers inside of string literals are not taken for comments, multiline literals are code lines
+ */
+void count_source(const symbol_t *data, size_t size, count_stats_t *stats);
+
+/**
+ * Counts all files in parallel and prints the stats of every file, every directory and the total
+ * @param roots Directories and files the paths were collected from, directories above them are not reported
+ * @param paths Files to count, should be sorted
+ * @param thread_count Count of threads, 0 to use all cores
+ * @return total stats
+ */
+count_stats_t count_report(const std::vector<std::string> &roots, const std::vector<std::string> &paths,
+                           int thread_count, FILE *out);
+
+#endif //CC_LABS_COUNT_H
@@ -0,0 +1,95 @@
+//
+// Source file access helpers shared by the lexer tools
+//
+
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "files.h"
+
+bool map_file(const char *path, mapped_file_t *file) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) || file_stat.st_size == 0) {
+        close(fd);
+        return false;
+    }
+    void *data = mmap(nullptr, (size_t) file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    madvise(data, (size_t) file_stat.st_size, MADV_SEQUENTIAL);
+    file->data = (const symbol_t *) data;
+    file->size = (size_t) file_stat.st_size;
+    return true;
+}
+
+void unmap_file(mapped_file_t *file) {
+    if (file->data != nullptr) {
+        munmap((void *) file->data, file->size);
+    }
+    file->data = nullptr;
+    file->size = 0;
+}
+
+uint64_t hash_content(const symbol_t *data, size_t size) {
+    const uint64_t prime = 0x9e3779b97f4a7c15ULL;
+    uint64_t hash = prime ^ (uint64_t) size;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        word *= 0xff51afd7ed558ccdULL;
+        word ^= word >> 32U;
+        hash = (hash ^ word) * prime;
+    }
+    for (; i < size; ++i) {
+        hash = (hash ^ (uint8_t) data[i]) * 0x100000001b3ULL;
+    }
+    hash ^= hash >> 29U;
+    return hash;
+}
+
+bool has_scala_extension(const char *name) {
+    size_t length = strlen(name);
+    return length > 6 && strcmp(name + length - 6, ".scala") == 0;
+}
+
+void collect_source_files(const char *root, std::vector<std::string> &paths) {
+    struct stat root_stat{};
+    if (stat(root, &root_stat) != 0) {
+        return;
+    }
+    if (!S_ISDIR(root_stat.st_mode)) {
+        paths.emplace_back(root);
+        return;
+    }
+    DIR *dir = opendir(root);
+    if (dir == nullptr) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        std::string path = std::string(root) + "/" + entry->d_name;
+        struct stat entry_stat{};
+        if (stat(path.c_str(), &entry_stat) != 0) {
+            continue;
+        }
+        if (S_ISDIR(entry_stat.st_mode)) {
+            collect_source_files(path.c_str(), paths);
+        } else if (S_ISREG(entry_stat.st_mode) && has_scala_extension(entry->d_name)) {
+            paths.push_back(path);
+        }
+    }
+    closedir(dir);
+}
@@ -0,0 +1,45 @@
+//
+// Source file access helpers shared by the lexer tools
+//
+
+#ifndef CC_LABS_FILES_H
+#define CC_LABS_FILES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "lexer.h"
+
+/// Read-only memory mapping of the whole file
+typedef struct {
+    const symbol_t *data;
+    size_t size;
+} mapped_file_t;
+
+/**
+ * Maps regular non-empty file into memory
+ * @return true, if the file was mapped
+ */
+bool map_file(const char *path, mapped_file_t *file);
+
+void unmap_file(mapped_file_t *file);
+
+/**
+ * Fast non-cryptographic hash of the file content
+ * @return 64-bit hash, which also depends on the size
+ */
+uint64_t hash_content(const symbol_t *data, size_t size);
+
+/// @return true, if the file name has .scala extension
+bool has_scala_extension(const char *name);
+
+/**
+ * Appends paths of all .scala files under the root to the list
+ * If the root is a file, it is appended as is
+ * @param root File or directory path
+ * @param paths List to append to
+ */
+void collect_source_files(const char *root, std::vector<std::string> &paths);
+
+#endif //CC_LABS_FILES_H
@@ -0,0 +1,273 @@
+//
+// Inverted identifier index over Scala source trees
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "files.h"
+#include "index.h"
+#include "lexer.h"
+
+/// occurrences of every term seen by one thread
+typedef std::unordered_map<std::string, std::vector<index_occurrence_t>> term_map_t;
+
+static inline uint64_t align8(uint64_t value) {
+    return (value + 7U) & ~(uint64_t) 7U;
+}
+
+static void put_varint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80U) {
+        out.push_back((uint8_t) (value | 0x80U));
+        value >>= 7U;
+    }
+    out.push_back((uint8_t) value);
+}
+
+static inline bool get_varint(const uint8_t **ptr, const uint8_t *end, uint64_t *value) {
+    uint64_t result = 0;
+    uint32_t shift = 0;
+    while (*ptr < end && shift < 70) {
+        uint8_t byte = *(*ptr)++;
+        result |= (uint64_t) (byte & 0x7FU) << shift;
+        if (!(byte & 0x80U)) {
+            *value = result;
+            return true;
+        }
+        shift += 7;
+    }
+    return false;
+}
+
+/**
+ * Lexes single file and appends its identifiers and keywords to the map
+ * Only identifiers and keywords are requested from the lexer, their payloads are never copied
+ */
+static void index_file(const char *path, uint32_t file_id, term_map_t &terms) {
+    mapped_file_t file{};
+    if (!map_file(path, &file)) {
+        return;
+    }
+    lex_reset();
+    lex_set_filter(TOKEN_MASK(TOKEN_IDENTIFIER) | TOKEN_MASK(TOKEN_KEYWORD));
+    lex_set_lazy_payload(1);
+    lex_input_buffer(file.data, file.size);
+    token_t token;
+    while (true) {
+        token = lex_next();
+        if (token.type == TOKEN_EOF) {
+            break;
+        }
+        index_occurrence_t occurrence{};
+        occurrence.file_id = file_id;
+        occurrence.offset = token.pos;
+        occurrence.kind = token.type == TOKEN_KEYWORD ? INDEX_KIND_KEYWORD : INDEX_KIND_IDENTIFIER;
+        terms[std::string(token.ident_value, token.length)].push_back(occurrence);
+    }
+    unmap_file(&file);
+}
+
+static bool occurrence_less(const index_occurrence_t &a, const index_occurrence_t &b) {
+    return a.file_id != b.file_id ? a.file_id < b.file_id : a.offset < b.offset;
+}
+
+int index_build(const char *index_path, const char **roots, int root_count, int thread_count) {
+    std::vector<std::string> paths;
+    for (int i = 0; i < root_count; ++i) {
+        collect_source_files(roots[i], paths);
+    }
+    std::sort(paths.begin(), paths.end());
+
+    if (thread_count <= 0) {
+        thread_count = (int) std::max(1U, std::thread::hardware_concurrency());
+    }
+    std::vector<term_map_t> thread_terms((size_t) thread_count);
+    std::vector<std::thread> threads;
+    std::atomic<uint32_t> next_file(0);
+    for (int t = 0; t < thread_count; ++t) {
+        threads.emplace_back([&, t]() {
+            uint32_t file_id;
+            while ((file_id = next_file.fetch_add(1)) < paths.size()) {
+                index_file(paths[file_id].c_str(), file_id, thread_terms[t]);
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    // merge per-thread maps, each file was lexed by exactly one thread
+    term_map_t &terms = thread_terms[0];
+    for (size_t t = 1; t < thread_terms.size(); ++t) {
+        for (auto &entry : thread_terms[t]) {
+            auto &target = terms[entry.first];
+            target.insert(target.end(), entry.second.begin(), entry.second.end());
+        }
+        term_map_t().swap(thread_terms[t]);
+    }
+    std::vector<const std::string *> names;
+    names.reserve(terms.size());
+    for (auto &entry : terms) {
+        std::sort(entry.second.begin(), entry.second.end(), occurrence_less);
+        names.push_back(&entry.first);
+    }
+    std::sort(names.begin(), names.end(), [](const std::string *a, const std::string *b) { return *a < *b; });
+
+    // lay out the string table and postings
+    std::vector<char> strings;
+    std::vector<uint32_t> file_path_offsets;
+    for (auto &path : paths) {
+        file_path_offsets.push_back((uint32_t) strings.size());
+        strings.insert(strings.end(), path.begin(), path.end());
+        strings.push_back('\0');
+    }
+    std::vector<index_term_t> term_entries;
+    std::vector<uint8_t> postings;
+    for (auto name : names) {
+        auto &occurrences = terms[*name];
+        index_term_t term{};
+        term.name_offset = (uint32_t) strings.size();
+        term.name_length = (uint32_t) name->size();
+        term.occurrence_count = (uint32_t) occurrences.size();
+        term.postings_offset = postings.size();
+        strings.insert(strings.end(), name->begin(), name->end());
+        strings.push_back('\0');
+        uint32_t prev_file = 0;
+        uint64_t prev_offset = 0;
+        for (auto &occurrence : occurrences) {
+            if (occurrence.file_id != prev_file) {
+                prev_offset = 0;
+            }
+            put_varint(postings, occurrence.file_id - prev_file);
+            put_varint(postings, ((occurrence.offset - prev_offset) << 1U) | occurrence.kind);
+            prev_file = occurrence.file_id;
+            prev_offset = occurrence.offset;
+        }
+        term.postings_size = (uint32_t) (postings.size() - term.postings_offset);
+        term_entries.push_back(term);
+    }
+
+    index_header_t header{};
+    header.magic = INDEX_MAGIC;
+    header.version = INDEX_VERSION;
+    header.file_count = (uint32_t) paths.size();
+    header.term_count = (uint32_t) term_entries.size();
+    header.files_offset = align8(sizeof(index_header_t));
+    header.terms_offset = align8(header.files_offset + sizeof(uint32_t) * file_path_offsets.size());
+    header.strings_offset = align8(header.terms_offset + sizeof(index_term_t) * term_entries.size());
+    header.postings_offset = align8(header.strings_offset + strings.size());
+
+    FILE *out = fopen(index_path, "wb");
+    if (out == nullptr) {
+        fprintf(stderr, "Unable to write index %s\n", index_path);
+        return -1;
+    }
+    static const uint8_t padding[8] = {0};
+    uint64_t written = 0;
+    auto write_section = [&](uint64_t offset, const void *data, size_t size) {
+        fwrite(padding, 1, offset - written, out);
+        fwrite(data, 1, size, out);
+        written = offset + size;
+    };
+    write_section(0, &header, sizeof(header));
+    write_section(header.files_offset, file_path_offsets.data(), sizeof(uint32_t) * file_path_offsets.size());
+    write_section(header.terms_offset, term_entries.data(), sizeof(index_term_t) * term_entries.size());
+    write_section(header.strings_offset, strings.data(), strings.size());
+    write_section(header.postings_offset, postings.data(), postings.size());
+    bool failed = ferror(out) != 0;
+    failed |= fclose(out) != 0;
+    if (failed) {
+        fprintf(stderr, "Unable to write index %s\n", index_path);
+        return -1;
+    }
+    return 0;
+}
+
+int index_open(index_t *index, const char *index_path) {
+    mapped_file_t file{};
+    if (!map_file(index_path, &file)) {
+        return -1;
+    }
+    index->data = (const uint8_t *) file.data;
+    index->size = file.size;
+    index->header = (const index_header_t *) index->data;
+    const index_header_t *header = index->header;
+    if (file.size < sizeof(index_header_t) ||
+        header->magic != INDEX_MAGIC || header->version != INDEX_VERSION ||
+        header->postings_offset > file.size) {
+        unmap_file(&file);
+        return -1;
+    }
+    index->file_path_offsets = (const uint32_t *) (index->data + header->files_offset);
+    index->terms = (const index_term_t *) (index->data + header->terms_offset);
+    index->strings = (const char *) (index->data + header->strings_offset);
+    index->postings = index->data + header->postings_offset;
+    return 0;
+}
+
+void index_close(index_t *index) {
+    mapped_file_t file{(const symbol_t *) index->data, index->size};
+    unmap_file(&file);
+    index->data = nullptr;
+    index->size = 0;
+}
+
+const index_term_t *index_find(const index_t *index, const char *name, size_t name_length) {
+    uint32_t low = 0;
+    uint32_t high = index->header->term_count;
+    while (low < high) {
+        uint32_t middle = low + (high - low) / 2;
+        const index_term_t *term = &index->terms[middle];
+        size_t common = std::min((size_t) term->name_length, name_length);
+        int cmp = memcmp(index->strings + term->name_offset, name, common);
+        if (cmp == 0) {
+            cmp = term->name_length < name_length ? -1 : (term->name_length > name_length ? 1 : 0);
+        }
+        if (cmp == 0) {
+            return term;
+        }
+        if (cmp < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return nullptr;
+}
+
+const char *index_file_path(const index_t *index, uint32_t file_id) {
+    if (file_id >= index->header->file_count) {
+        return nullptr;
+    }
+    return index->strings + index->file_path_offsets[file_id];
+}
+
+void index_cursor_init(const index_t *index, const index_term_t *term, index_cursor_t *cursor) {
+    cursor->ptr = index->postings + term->postings_offset;
+    cursor->end = cursor->ptr + term->postings_size;
+    cursor->file_id = 0;
+    cursor->offset = 0;
+}
+
+bool index_cursor_next(index_cursor_t *cursor, index_occurrence_t *occurrence) {
+    uint64_t file_delta;
+    uint64_t offset_delta;
+    if (!get_varint(&cursor->ptr, cursor->end, &file_delta) ||
+        !get_varint(&cursor->ptr, cursor->end, &offset_delta)) {
+        return false;
+    }
+    if (file_delta != 0) {
+        cursor->file_id += (uint32_t) file_delta;
+        cursor->offset = 0;
+    }
+    cursor->offset += offset_delta >> 1U;
+    occurrence->file_id = cursor->file_id;
+    occurrence->offset = cursor->offset;
+    occurrence->kind = (uint8_t) (offset_delta & 1U);
+    return true;
+}
@@ -0,0 +1,115 @@
+//
+// Inverted identifier index over Scala source trees
+//
+
+#ifndef CC_LABS_INDEX_H
+#define CC_LABS_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// "SCIX" in little-endian
+#define INDEX_MAGIC         0x58494353U
+#define INDEX_VERSION       1U
+
+/// occurrence kinds
+#define INDEX_KIND_IDENTIFIER   0U
+#define INDEX_KIND_KEYWORD      1U
+
+/**
+ * Index file header
+ * The file is laid out as follows, all integers are little-endian, sections are 8-byte aligned:
+ *   index_header_t
+ *   uint32_t file_path_offsets[file_count]  - offsets of null-terminated file paths in the string table
+ *   index_term_t terms[term_count]          - sorted by name, looked up with binary search
+ *   string table                            - file paths and term names
+ *   postings                                - per term varint stream of occurrences sorted by (file, offset)
+ *                                             each one is (file_id delta, offset delta << 1 | kind),
+ *                                             offset delta restarts from zero in every file,
+ *                                             varints are up to 64-bit, so files may exceed 4 GiB
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t file_count;
+    uint32_t term_count;
+    uint64_t files_offset;
+    uint64_t terms_offset;
+    uint64_t strings_offset;
+    uint64_t postings_offset;
+} index_header_t;
+
+/// Index entry of one identifier or keyword
+typedef struct {
+    /// name position in the string table
+    uint32_t name_offset;
+    uint32_t name_length;
+    uint32_t occurrence_count;
+    uint32_t postings_size;
+    /// postings position relative to the postings section
+    uint64_t postings_offset;
+} index_term_t;
+
+/// Single occurrence of the term
+typedef struct {
+    uint64_t offset;
+    uint32_t file_id;
+    uint8_t kind;
+} index_occurrence_t;
+
+/// Index file mapped into memory
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+    const index_header_t *header;
+    const uint32_t *file_path_offsets;
+    const index_term_t *terms;
+    const char *strings;
+    const uint8_t *postings;
+} index_t;
+
+/// Sequential reader of the term postings
+typedef struct {
+    const uint8_t *ptr;
+    const uint8_t *end;
+    uint32_t file_id;
+    uint64_t offset;
+} index_cursor_t;
+
+/**
+ * Lexes all .scala files under the roots in parallel and writes the index
+ * @param index_path Path of the index file to write
+ * @param roots Files or directories to index
+ * @param root_count Count of roots
+ * @param thread_count Count of lexing threads, 0 to use all cores
+ * @return 0 on success, -1 otherwise
+ */
+int index_build(const char *index_path, const char **roots, int root_count, int thread_count);
+
+/**
+ * Maps the index file into memory
+ * @return 0 on success, -1 if the file is missing or is not an index
+ */
+int index_open(index_t *index, const char *index_path);
+
+void index_close(index_t *index);
+
+/**
+ * Looks up the term in the index
+ * @return term entry or nullptr, if the name was never seen
+ */
+const index_term_t *index_find(const index_t *index, const char *name, size_t name_length);
+
+/// returns null-terminated path of the file with given id
+const char *index_file_path(const index_t *index, uint32_t file_id);
+
+/// prepares cursor to read the postings of the term
+void index_cursor_init(const index_t *index, const index_term_t *term, index_cursor_t *cursor);
+
+/**
+ * Decodes next occurrence of the term
+ * @return true, if the occurrence was read, false at the end of postings
+ */
+bool index_cursor_next(index_cursor_t *cursor, index_occurrence_t *occurrence);
+
+#endif //CC_LABS_INDEX_H
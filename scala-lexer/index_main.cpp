@@ -0,0 +1,79 @@
+//
+// scala_index: builds and queries the identifier index
+//
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "index.h"
+#include "lexer.h"
+
+void on_lex_error(const char *error_desc) {
+    fprintf(stderr, "%s\n", error_desc);
+}
+
+static void print_usage() {
+    printf("Usage:\n"
+           "\tscala_index build <index file> <source dir or file>... [-j <threads>]\n"
+           "\tscala_index query <index file> <identifier>...\n");
+}
+
+static int build(int argc, const char **argv) {
+    int thread_count = 0;
+    const char *roots[argc];
+    int root_count = 0;
+    for (int i = 3; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            thread_count = atoi(argv[++i]);
+        } else {
+            roots[root_count++] = argv[i];
+        }
+    }
+    if (root_count == 0) {
+        print_usage();
+        return 1;
+    }
+    return index_build(argv[2], roots, root_count, thread_count) == 0 ? 0 : 1;
+}
+
+static int query(int argc, const char **argv) {
+    index_t index{};
+    if (index_open(&index, argv[2]) != 0) {
+        printf("Unable to open index %s\n", argv[2]);
+        return 1;
+    }
+    for (int i = 3; i < argc; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        const index_term_t *term = index_find(&index, argv[i], strlen(argv[i]));
+        if (term == nullptr) {
+            printf("%s: not found\n", argv[i]);
+            continue;
+        }
+        index_cursor_t cursor{};
+        index_occurrence_t occurrence{};
+        index_cursor_init(&index, term, &cursor);
+        while (index_cursor_next(&cursor, &occurrence)) {
+            printf("%s:%llu %s\n", index_file_path(&index, occurrence.file_id),
+                   (unsigned long long) occurrence.offset,
+                   occurrence.kind == INDEX_KIND_KEYWORD ? "keyword" : "ident");
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start);
+        fprintf(stderr, "%s: %u occurrences, %lld us\n", argv[i], term->occurrence_count,
+                (long long) elapsed.count());
+    }
+    index_close(&index);
+    return 0;
+}
+
+int main(int argc, const char **argv) {
+    if (argc > 3 && strcmp(argv[1], "build") == 0) {
+        return build(argc, argv);
+    }
+    if (argc > 3 && strcmp(argv[1], "query") == 0) {
+        return query(argc, argv);
+    }
+    print_usage();
+    return 1;
+}
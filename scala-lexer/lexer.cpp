@@ -11,24 +11,29 @@
 #include <malloc.h>
 #include <cstdlib>
 #include "lexer.h"
+#include "profile.h"
 
+/// the prefix takes 15 symbols and at most 20 for the position with its sign
 #define REPORT_ERROR_WITH_POS(str) {            \
     size_t str_len = strlen(str);               \
-    char buffer[str_len + 32];                  \
-    sprintf(buffer,"at position %d : %s",       \
-            input_symbols_ptr,str);             \
+    char buffer[str_len + 15 + 20 + 1];         \
+    snprintf(buffer, sizeof(buffer), "at position %lld : %s", \
+             (long long) (input_symbols_base + input_symbols_ptr),str); \
         on_lex_error(buffer);                       \
     }
 
 #define COMMIT() ++input_symbols_ptr;
 
+/// fetches next symbol inside of the lexer core specialized for Policy
+#define LEX_NEXT_SYMBOL() lex_fetch_symbol<Policy::positions>()
+
 #define COMMENT_CHECK(c1)                   \
-    comment_skipping(c1);                   \
-    c1 = lex_next_symbol();
+    comment_skipping<Policy>(c1);           \
+    c1 = LEX_NEXT_SYMBOL();
 
 #define COMMIT_AND_SHIFT(var_name)          \
     COMMIT()                                \
-    symbol_t var_name = lex_next_symbol();
+    symbol_t var_name = LEX_NEXT_SYMBOL();
 
 #define HEX_TO_INT(x) (x) < 58 ? (x) - 48 : \
     ((x) > 96 ? (x) - 87 : (x) - 55)
@@ -65,205 +70,530 @@
 /// returns 1 if a == '`', zero otherwise
 #define IS_BACKQUOTE(x) ((x)=='`')
 
-/// read block size while fetching input stream to the buffer
-#define IN_BUFFER_SIZE 4096
+/// size of the input stream window
+#define IN_BUFFER_SIZE 65536
+/// the window is refilled at a token boundary if fewer symbols are left, so lookahead of ordinary tokens
+/// (""", >>>=, \uXXXX) never crosses its end
+#define IN_BUFFER_LOOKAHEAD 4096
+/// zero sentinels after the window content, scan loops stop at them without bounds checks
+#define IN_BUFFER_PADDING 64
+
+// Lexer state is kept per thread, so independent inputs can be lexed in parallel
 
-/// limits the maximum size of literals and identifiers
+/// initial size of the accumulation buffer, it grows geometrically for longer literals and identifiers
 #define ACCUM_BUFFER_SIZE 256
 
-FILE *input_file = nullptr;
+thread_local FILE *input_file = nullptr;
+
+/// input stream window, followed by the sentinel padding
+alignas(64) thread_local symbol_t lex_stream_buffer[IN_BUFFER_SIZE + IN_BUFFER_PADDING];
 
-/// input buffer
-symbol_t lex_buffer[IN_BUFFER_SIZE];
+/// current input window, either lex_stream_buffer or the whole buffer passed to lex_input_buffer()
+thread_local const symbol_t *lex_buffer = lex_stream_buffer;
+
+/// true if the input is a caller-provided buffer (e.g. mmap'd file), which is never refilled
+thread_local bool input_mapped = false;
+/// true if the input stream has no more symbols
+thread_local bool input_eof = false;
 
 /// output accumulation buffer
-symbol_t initial_accum_buffer[ACCUM_BUFFER_SIZE];
-symbol_t *accum_buffer = initial_accum_buffer;
+thread_local symbol_t initial_accum_buffer[ACCUM_BUFFER_SIZE];
+thread_local symbol_t *accum_buffer = initial_accum_buffer;
+
+// positions and sizes are 64-bit, so inputs over 2 GiB are lexed as well
 
 /// count of read symbols in the buffer
-int32_t input_symbols_size = 0;
+thread_local int64_t input_symbols_size = 0;
 /// points to the out_buffer position
-int32_t input_symbols_ptr = 0;
+thread_local int64_t input_symbols_ptr = 0;
+/// count of symbols consumed before the current buffer
+thread_local int64_t input_symbols_base = 0;
 
 /// current size of the accumulation buffer
-int32_t accum_symbols_size = 0;
-int32_t accum_symbols_cap = ACCUM_BUFFER_SIZE;
+thread_local int64_t accum_symbols_size = 0;
+thread_local int64_t accum_symbols_cap = ACCUM_BUFFER_SIZE;
+
+/// kinds of tokens returned by lex_next(), see lex_set_filter()
+thread_local uint32_t lex_filter_mask = TOKEN_MASK_ALL;
+/// if true, lex_next() does not copy payloads, see lex_set_lazy_payload()
+thread_local bool lex_lazy_payload = false;
 
 /// Line number and offset calculation required variables
-int new_lines_num = 0;
-int last_new_line_pos = -1;
-int prev_new_line_pos = -1;
-
-
-bool isKeyword() {
-    char keywords[50][10] = {"abstract", "case", "catch", "class", "def",
-                             "do", "else", "extends", "false", "final",
-                             "finally", "for", "forSome", "if", "implicit",
-                             "import", "lazy", "macro", "match", "new",
-                             "null", "object", "override", "package", "private",
-                             "protected", "return", "sealed", "super", "this",
-                             "throw", "trait", "try", "true", "type",
-                             "val", "var", "while", "with", "yield",
-                             "_", ":", "=", "=>", "<-", "<:", "<%", ">:", "#", "@"};
-    for (int i = 0; i < 50; ++i) {
+thread_local int64_t new_lines_num = 0;
+thread_local int64_t last_new_line_pos = -1;
+thread_local int64_t prev_new_line_pos = -1;
+
+
+/**
+ * Looks up the accumulated symbols in the keyword table
+ * @return KEYWORD_* code of the keyword, 0 if it is not a keyword
+ */
+uint32_t lookup_keyword() {
+    // ordered by KEYWORD_* codes
+    static const char keywords[50][10] = {"abstract", "case", "catch", "class", "def",
+                                          "do", "else", "extends", "false", "final",
+                                          "finally", "for", "forSome", "if", "implicit",
+                                          "import", "lazy", "macro", "match", "new",
+                                          "null", "object", "override", "package", "private",
+                                          "protected", "return", "sealed", "super", "this",
+                                          "throw", "trait", "try", "true", "type",
+                                          "val", "var", "while", "with", "yield",
+                                          "_", ":", "=", "=>", "<-", "<:", "<%", ">:", "#", "@"};
+    for (uint32_t i = 0; i < 50; ++i) {
         if (strcmp(keywords[i], accum_buffer) == 0) {
-            return true;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Looks up the accumulated operator symbols in the operator table
+ * @return OP_* code of the operator, 0 if it is a user-defined operator
+ */
+uint32_t lookup_operator() {
+    static const struct {
+        char symbols[4];
+        uint32_t code;
+    } operators[] = {{"+",   OP_ADD},           {"-",   OP_SUB},          {"*",   OP_MULT},
+                     {"/",   OP_DIV},           {"%",   OP_MOD},          {"**",  OP_EXP},
+                     {"==",  OP_EQ_TO},         {"!=",  OP_NEQ_TO},       {">",   OP_GT_THAN},
+                     {"<",   OP_LS_THAN},       {">=",  OP_GT_THAN_EQ_TO}, {"<=",  OP_LS_THAN_EQ_TO},
+                     {"&&",  OP_L_AND},         {"||",  OP_L_OR},         {"!",   OP_L_NOT},
+                     {"=",   OP_ASSIGN},        {"+=",  OP_ADD_ASSIGN},   {"-=",  OP_SUB_ASSIGN},
+                     {"*=",  OP_MULT_ASSIGN},   {"/=",  OP_DIV_ASSIGN},   {"%=",  OP_MOD_ASSIGN},
+                     {"**=", OP_EXP_ASSIGN},    {"<<=", OP_LSH_ASSIGN},   {">>=", OP_RSH_ASSIGN},
+                     {"&=",  OP_B_AND_ASSIGN},  {"|=",  OP_B_OR_ASSIGN},  {"^=",  OP_B_XOR_ASSIGN},
+                     {"&",   OP_B_AND},         {"|",   OP_B_OR},         {"^",   OP_B_XOR},
+                     {"<<",  OP_LSH},           {">>",  OP_RSH},          {"~",   OP_COMPL},
+                     {">>>", OP_RSH_Z}};
+    if (accum_symbols_size > 3) {
+        return 0;
+    }
+    for (auto &oper : operators) {
+        if (strcmp(oper.symbols, accum_buffer) == 0) {
+            return oper.code;
         }
     }
-    return false;
+    return 0;
 }
 
 
 /**
- * On demand returns next symbol of the input stream via block reading of descriptor input data flow
- * Do not shift the stream current pointer (do --symbols_left if the symbol was taken from the stream)
- * @return next symbol of lexer input stream
+ * Moves unread symbols of the stream window to its beginning and reads the input after them
+ * Newline positions move with the window, the symbols after the read ones are set to zero sentinels
+ * @return true, if any symbols were read
  */
-symbol_t lex_next_symbol() {
+static bool lex_refill_window() {
+    if (input_eof) {
+        return false;
+    }
     if (input_file == nullptr) {
         input_file = stdin;
     }
-    if (input_symbols_ptr >= input_symbols_size) {
-        input_symbols_size = fread(lex_buffer, 1, IN_BUFFER_SIZE, input_file);
-        if (input_symbols_size == 0) {
-            int code = ferror(input_file);
-            if (code) {
-                printf("error %d occurred while reading\n", code);
-            }
-            input_symbols_size = 0;
+    int64_t shift = input_symbols_ptr < input_symbols_size ? input_symbols_ptr : input_symbols_size;
+    int64_t kept = input_symbols_size - shift;
+    memmove(lex_stream_buffer, lex_stream_buffer + shift, sizeof(symbol_t) * kept);
+    input_symbols_base += shift;
+    input_symbols_ptr -= shift;
+    last_new_line_pos -= shift;
+    prev_new_line_pos -= shift;
+    size_t count = fread(lex_stream_buffer + kept, 1, IN_BUFFER_SIZE - kept, input_file);
+    if (count == 0) {
+        int code = ferror(input_file);
+        if (code) {
+            printf("error %d occurred while reading\n", code);
+        }
+        input_eof = true;
+    }
+    input_symbols_size = kept + (int64_t) count;
+    memset(lex_stream_buffer + input_symbols_size, 0, sizeof(symbol_t) * IN_BUFFER_PADDING);
+    return count > 0;
+}
+
+/**
+ * Returns current symbol of the input, without shifting the current pointer (see COMMIT())
+ * Stream window is refilled here only if a token crosses its end, which is detected by the zero sentinel
+ * @tparam Positions track newlines for token line numbers
+ * @return next symbol of lexer input stream
+ */
+template<bool Positions>
+static inline symbol_t lex_fetch_symbol() {
+    PROFILE_SCOPE("lex_next_symbol")
+    symbol_t symbol;
+    if (input_mapped) {
+        if (input_symbols_ptr >= input_symbols_size) {
             return '\0';
         }
-        input_symbols_ptr = 0;
+        symbol = lex_buffer[input_symbols_ptr];
+    } else {
+        symbol = lex_buffer[input_symbols_ptr];
+        if (symbol == '\0' && input_symbols_ptr >= input_symbols_size) {
+            if (!lex_refill_window()) {
+                // keep the pointer inside of the padding, however many times EOF is committed
+                input_symbols_ptr = input_symbols_size;
+                return '\0';
+            }
+            symbol = lex_buffer[input_symbols_ptr];
+        }
     }
-    if ((char) lex_buffer[input_symbols_ptr] == '\n' && input_symbols_ptr != last_new_line_pos) {
+    if (Positions && symbol == '\n' && input_symbols_ptr != last_new_line_pos) {
         new_lines_num++;
         prev_new_line_pos = last_new_line_pos;
         last_new_line_pos = input_symbols_ptr;
     }
-    symbol_t ret = lex_buffer[input_symbols_ptr];
-    return ret;
+    return symbol;
+}
+
+symbol_t lex_next_symbol() {
+    return lex_fetch_symbol<true>();
 }
 
 symbol_t peek() {
-    if (input_file == nullptr) {
-        input_file = stdin;
+    if (input_mapped) {
+        return input_symbols_ptr + 1 < input_symbols_size ? lex_buffer[input_symbols_ptr + 1] : '\0';
     }
-    if (input_symbols_ptr >= input_symbols_size) {
-        input_symbols_size = fread(lex_buffer, 1, IN_BUFFER_SIZE, input_file);
-        if (input_symbols_size == 0) {
-            int code = 0;
-            code = ferror(input_file);
-            if (code) {
-                printf("error %d occurred while reading\n", code);
-            }
-            input_symbols_size = 0;
-            return '\0';
+    symbol_t symbol = lex_buffer[input_symbols_ptr + 1];
+    if (symbol == '\0' && input_symbols_ptr + 1 >= input_symbols_size && lex_refill_window()) {
+        symbol = lex_buffer[input_symbols_ptr + 1];
+    }
+    return symbol;
+}
+
+/**
+ * Doubles the capacity of the accumulation buffer, preserving its content
+ * The grown buffer is kept for the next tokens, so each literal costs amortized O(1) per symbol
+ */
+static void lex_grow_accum_buffer() {
+    int64_t new_cap = accum_symbols_cap * 2;
+    if (accum_buffer == initial_accum_buffer) {
+        accum_buffer = (symbol_t *) malloc(sizeof(symbol_t) * new_cap);
+        if (accum_buffer != nullptr) {
+            memcpy(accum_buffer, initial_accum_buffer, sizeof(symbol_t) * accum_symbols_cap);
         }
-        input_symbols_ptr = 0;
+    } else {
+        accum_buffer = (symbol_t *) realloc(accum_buffer, sizeof(symbol_t) * new_cap);
     }
-    symbol_t ret = lex_buffer[input_symbols_ptr + 1];
-    return ret;
+    if (accum_buffer == nullptr) {
+        on_lex_error("unable to grow accumulation buffer");
+        exit(1);
+    }
+    bzero(accum_buffer + accum_symbols_cap, sizeof(symbol_t) * (new_cap - accum_symbols_cap));
+    accum_symbols_cap = new_cap;
 }
 
 /**
  * Saves symbol to the accumulation buffer
+ * One free symbol is always kept after the content, so the buffer stays null-terminated
  * @param symbol Symbol to save
  * @return new accum_symbols_size
  */
-static inline int lex_accum_symbol(symbol_t symbol) {
-    if (accum_symbols_size == accum_symbols_cap) {
-        if (accum_symbols_size == ACCUM_BUFFER_SIZE) {
-            accum_buffer = (symbol_t *) malloc(sizeof(symbol_t) * accum_symbols_cap * 2);
-        } else {
-            accum_buffer = (symbol_t *) realloc(accum_buffer, sizeof(symbol_t) * accum_symbols_cap * 2);
-        }
+static inline int64_t lex_accum_symbol(symbol_t symbol) {
+    if (accum_symbols_size + 1 >= accum_symbols_cap) {
+        lex_grow_accum_buffer();
     }
     accum_buffer[accum_symbols_size] = symbol;
+    accum_buffer[accum_symbols_size + 1] = '\0';
     return ++accum_symbols_size;
 }
 
+/// returns true, if the payload of the token of this type should be built
+static inline bool lex_payload_wanted(uint8_t type) {
+    return (lex_filter_mask & TOKEN_MASK(type)) != 0;
+}
+
+/// returns true, if the payload of the token of this type should be built by the core specialized for Policy
+template<typename Policy>
+static inline bool lex_payload_built(uint8_t type) {
+    return Policy::payloads && (!Policy::options || lex_payload_wanted(type));
+}
+
+/// payload lengths are 32-bit to keep token_t compact, longer payloads are reported and truncated
+static inline uint32_t lex_token_length(uint64_t length) {
+    if (length > UINT32_MAX) {
+        on_lex_error("token payload is longer than 4 GiB, it is truncated");
+        return UINT32_MAX;
+    }
+    return (uint32_t) length;
+}
+
+/**
+ * Moves first n_size accumulated symbols to the token payload and resets the accumulation buffer
+ * Payload is copied to a new null-terminated buffer, lazy tokens point to the accumulation buffer instead,
+ * and tokens skipped by the filter get no payload at all
+ * @return payload of the token
+ */
+template<typename Policy>
+static char *lex_take_accum(token_t *token, size_t n_size) {
+    char *value = nullptr;
+    token->length = lex_token_length(n_size);
+    if (!lex_payload_built<Policy>(token->type)) {
+        token->length = 0;
+    } else if (Policy::options && lex_lazy_payload) {
+        accum_buffer[n_size] = '\0';
+        token->flags |= TOKEN_FLAG_LAZY;
+        value = accum_buffer;
+    } else {
+        value = new char[n_size + 1];
+        memcpy(value, accum_buffer, n_size);
+        value[n_size] = '\0';
+    }
+    accum_symbols_size = 0;
+    return value;
+}
+
+/// accumulates payload symbol, if the payloads are built by the core specialized for Policy
+#define LEX_ACCUM_PAYLOAD(symbol)           \
+    if (Policy::payloads) {                 \
+        lex_accum_symbol(symbol);           \
+    }
+
+/// accumulates literal symbol only if it can not be sliced from the mapped input later
+#define LEX_ACCUM_LITERAL(symbol)           \
+    if (Policy::payloads && !input_mapped) {\
+        lex_accum_symbol(symbol);           \
+    }
+
+template<typename Policy>
 int build_integer_literal(token_t *token, uint8_t is_hex);
 
+template<typename Policy>
 int build_float_literal(token_t *token, uint8_t is_double);
 
-int build_string_literal(token_t *token, uint8_t has_trailing_quotes);
+template<typename Policy>
+int build_string_literal(token_t *token, uint8_t has_trailing_quotes, int64_t literal_start);
+
+template<typename Policy>
+int build_slice(token_t *token, uint8_t type, int64_t trailing_size, int64_t slice_start);
 
 void lex_input(FILE *input_desc) {
     input_file = input_desc;
 }
 
+void lex_set_filter(uint32_t mask) {
+    lex_filter_mask = mask;
+}
+
+void lex_set_lazy_payload(bool_t lazy) {
+    lex_lazy_payload = lazy != 0;
+}
+
+void lex_materialize(token_t *token) {
+    if (!(token->flags & TOKEN_FLAG_LAZY)) {
+        return;
+    }
+    char **payload = &token->ident_value;
+    if (token->type == TOKEN_FLOAT_LITERAL) {
+        payload = &token->float_value;
+    } else if (token->type == TOKEN_STRING_LITERAL) {
+        payload = &token->string_value;
+    }
+    char *value = new char[token->length + 1];
+    memcpy(value, *payload, token->length);
+    value[token->length] = '\0';
+    *payload = value;
+    token->flags &= ~TOKEN_FLAG_LAZY;
+}
+
+void lex_reset() {
+    input_file = nullptr;
+    lex_buffer = lex_stream_buffer;
+    input_mapped = false;
+    input_eof = false;
+    memset(lex_stream_buffer, 0, sizeof(symbol_t) * IN_BUFFER_PADDING);
+    input_symbols_size = 0;
+    input_symbols_ptr = 0;
+    input_symbols_base = 0;
+    accum_symbols_size = 0;
+    new_lines_num = 0;
+    last_new_line_pos = -1;
+    prev_new_line_pos = -1;
+}
+
+void lex_input_buffer(const symbol_t *buffer, size_t size) {
+    lex_buffer = buffer;
+    input_mapped = true;
+    input_symbols_size = (int64_t) size;
+    input_symbols_ptr = 0;
+}
+
+void lex_seek(size_t pos) {
+    if (!input_mapped) {
+        return;
+    }
+    if ((int64_t) pos > input_symbols_size) {
+        pos = (size_t) input_symbols_size;
+    }
+    // account newlines of the skipped region, so line numbers of further tokens are kept
+    for (int64_t i = input_symbols_ptr; i < (int64_t) pos; ++i) {
+        auto newline = (const symbol_t *) memchr(lex_buffer + i, '\n', pos - i);
+        if (newline == nullptr) {
+            break;
+        }
+        i = (int64_t) (newline - lex_buffer);
+        if (i != last_new_line_pos) {
+            new_lines_num++;
+            prev_new_line_pos = last_new_line_pos;
+            last_new_line_pos = i;
+        }
+    }
+    input_symbols_ptr = (int64_t) pos;
+    accum_symbols_size = 0;
+}
+
+template<typename Policy>
 void comment_skipping(symbol_t c1) {
+    PROFILE_SCOPE("comment_skipping")
     if (c1 == '/') {
         if (peek() != '/' && peek() != '*')
             return;
         COMMIT()
-        c1 = lex_next_symbol();
+        c1 = LEX_NEXT_SYMBOL();
         COMMIT()
         if (c1 == '/') {
             //this is a comment
             while (c1 != '\n' && c1 != '\0') {
-                c1 = lex_next_symbol();
+                c1 = LEX_NEXT_SYMBOL();
                 COMMIT()
             }
         } else if (c1 == '*') {
 
-            c1 = lex_next_symbol();
+            c1 = LEX_NEXT_SYMBOL();
             COMMIT()
             bool ok = false;
-            while (lex_next_symbol() != '\0') {
-                if (c1 == '*' && lex_next_symbol() == '/') {
+            while (LEX_NEXT_SYMBOL() != '\0') {
+                if (c1 == '*' && LEX_NEXT_SYMBOL() == '/') {
                     COMMIT()
                     ok = true;
                     break;
                 }
-                c1 = lex_next_symbol();
-                if (lex_next_symbol() != '\0')
+                c1 = LEX_NEXT_SYMBOL();
+                if (LEX_NEXT_SYMBOL() != '\0')
                     COMMIT()
 
             }
             if (!ok) {
+                // the rest of the input is the comment, so the next token is EOF
                 REPORT_ERROR_WITH_POS("Compilation ERROR. Comment */ is not closed")
-                exit(0);
             }
 
         }
     }
 
-    if (lex_next_symbol() == '/') comment_skipping(lex_next_symbol());
+    if (LEX_NEXT_SYMBOL() == '/') comment_skipping<Policy>(LEX_NEXT_SYMBOL());
 }
 
-token_t lex_next() {
-    // main function of the lexer
-    token_t token;
-    // non-initialized token type
-    token.type = 0;
-    // initialize only ident_value since pointer
-    // has equal or the most size in the union
-    token.ident_value = nullptr;
-    symbol_t c1 = lex_next_symbol();
-
-    // retrieving current line number and offset and adding to the token
-    // int curr_line = new_lines_num + 1;
-    // int curr_offset = input_symbols_ptr - last_new_line_pos + 1;
-    while ((c1 = lex_next_symbol()) == ' ') {
-        COMMIT()
+/**
+ * Fills position of the token starting at the current symbol, which should be already fetched
+ */
+template<typename Policy>
+static inline void lex_mark_position(token_t *token) {
+    if (!Policy::positions) {
+        token->pos = 0;
+        token->line = 0;
+        token->offset = 0;
+        return;
     }
+    token->pos = (uint64_t) (input_symbols_base + input_symbols_ptr);
+    int64_t offset;
+    if (last_new_line_pos == input_symbols_ptr) {
+        token->line = (uint32_t) new_lines_num;
+        offset = input_symbols_ptr - prev_new_line_pos;
+    } else {
+        token->line = (uint32_t) (new_lines_num + 1);
+        offset = input_symbols_ptr - last_new_line_pos;
+    }
+    token->offset = offset > UINT32_MAX ? UINT32_MAX : (uint32_t) offset;
+}
 
-    COMMENT_CHECK(c1)
+/**
+ * Reads the comment starting at the current symbol as a trivia token
+ * Unlike comment_skipping(), the newline after the line comment is left for the delimiter token
+ */
+template<typename Policy>
+static void lex_scan_comment(token_t *token, symbol_t c1) {
+    int64_t comment_start = input_symbols_ptr;
+    LEX_ACCUM_LITERAL(c1)
+    COMMIT_AND_SHIFT(c2)
+    LEX_ACCUM_LITERAL(c2)
+    COMMIT_AND_SHIFT(s)
+    if (c2 == '/') {
+        while (s != '\n' && s != '\0') {
+            LEX_ACCUM_LITERAL(s)
+            COMMIT()
+            s = LEX_NEXT_SYMBOL();
+        }
+    } else {
+        symbol_t prev = 0;
+        bool closed = false;
+        while (s != '\0') {
+            LEX_ACCUM_LITERAL(s)
+            COMMIT()
+            if (prev == '*' && s == '/') {
+                closed = true;
+                break;
+            }
+            prev = s;
+            s = LEX_NEXT_SYMBOL();
+        }
+        if (!closed) {
+            REPORT_ERROR_WITH_POS("Compilation ERROR. Comment */ is not closed")
+        }
+    }
+    build_slice<Policy>(token, TOKEN_COMMENT, 0, comment_start);
+}
 
-    if (last_new_line_pos == input_symbols_ptr) {
-        token.line = new_lines_num;
-        token.offset = input_symbols_ptr - prev_new_line_pos;
+/**
+ * Extracts next token of any kind from the input stream
+ * Payload is built only if the token passes the filter
+ * @tparam Policy lex_policy_t, which selects the features compiled into this core
+ */
+template<typename Policy>
+static token_t lex_scan() {
+    // every field and the whole union are zeroed, so branches may leave payloads they do not set
+    token_t token{};
+    if (!input_mapped && input_symbols_size - input_symbols_ptr < IN_BUFFER_LOOKAHEAD) {
+        // token boundary, so the unread symbols are the only ones to carry over
+        lex_refill_window();
+    }
+    symbol_t c1 = LEX_NEXT_SYMBOL();
+
+    if (Policy::trivia) {
+        // whitespaces and comments are tokens too
+        lex_mark_position<Policy>(&token);
+        if (c1 == ' ' || c1 == '\t' || c1 == '\r') {
+            int64_t space_start = input_symbols_ptr;
+            do {
+                LEX_ACCUM_LITERAL(c1)
+                COMMIT()
+                c1 = LEX_NEXT_SYMBOL();
+            } while (c1 == ' ' || c1 == '\t' || c1 == '\r');
+            build_slice<Policy>(&token, TOKEN_WHITESPACE, 0, space_start);
+            return token;
+        }
+        if (c1 == '/' && (peek() == '/' || peek() == '*')) {
+            lex_scan_comment<Policy>(&token, c1);
+            return token;
+        }
     } else {
-        token.line = new_lines_num + 1;
-        token.offset = input_symbols_ptr - last_new_line_pos;
+        // skip whitespaces and comments, which may be followed by indentation
+        while (true) {
+            while ((c1 = LEX_NEXT_SYMBOL()) == ' ' || c1 == '\t' || c1 == '\r') {
+                COMMIT()
+            }
+            if (c1 != '/' || (peek() != '/' && peek() != '*')) {
+                break;
+            }
+            COMMENT_CHECK(c1)
+        }
+        lex_mark_position<Policy>(&token);
     }
 
     if (IS_BACKQUOTE(c1)) {
         // back quote starting identifier, read everything until next backquote
         // newlines are not allowed
         COMMIT()
-        symbol_t next = lex_next_symbol();
+        symbol_t next = LEX_NEXT_SYMBOL();
         while (!IS_BACKQUOTE(next)) {
             COMMIT()
             if (next == '\n') { //newline is an error
@@ -274,20 +604,14 @@ token_t lex_next() {
                 REPORT_ERROR_WITH_POS("eof while reading back-quoted identifier")
                 break;
             }
-            lex_accum_symbol(next);
-            next = lex_next_symbol();
+            LEX_ACCUM_PAYLOAD(next)
+            next = LEX_NEXT_SYMBOL();
         }
         // check is the lexing was succeed
         if (IS_BACKQUOTE(next)) {
             COMMIT()
-            size_t n_size = sizeof(token_t) * accum_symbols_size;
-            char *ident_value = new char[n_size + 1];
-            bzero(ident_value, n_size + 1);
-            memcpy(ident_value, accum_buffer, n_size);
-            bzero(accum_buffer, n_size);
-            accum_symbols_size = 0;
             token.type = TOKEN_IDENTIFIER;
-            token.ident_value = ident_value;
+            token.ident_value = lex_take_accum<Policy>(&token, sizeof(symbol_t) * accum_symbols_size);
             return token;
         } else {
             return token;
@@ -295,52 +619,42 @@ token_t lex_next() {
     }
     if (IS_OPER(c1)) {
         // operator identifier begins with operator character
-        lex_accum_symbol(c1);
+        LEX_ACCUM_PAYLOAD(c1)
         COMMIT()
-        symbol_t next = lex_next_symbol();
+        symbol_t next = LEX_NEXT_SYMBOL();
         while (IS_OPER(next)) {
-            lex_accum_symbol(next);
+            LEX_ACCUM_PAYLOAD(next)
             COMMIT()
-            next = lex_next_symbol();
+            next = LEX_NEXT_SYMBOL();
         }
-        size_t n_size = sizeof(symbol_t) * accum_symbols_size;
-        char *ident_value = new char[n_size + 1];
-        bzero(ident_value, n_size + 1);
-        memcpy(ident_value, accum_buffer, n_size);
-        bzero(accum_buffer, n_size);
-        accum_symbols_size = 0;
         token.type = TOKEN_IDENTIFIER;
-        token.ident_value = ident_value;
+        token.oper = Policy::payloads ? lookup_operator() : 0;
+        token.ident_value = lex_take_accum<Policy>(&token, sizeof(symbol_t) * accum_symbols_size);
         return token;
     }
     if (IS_LETTER(c1) || c1 == '_' || c1 == '$') {
         // keyword or identifier
         lex_accum_symbol(c1);
         COMMIT()
-        symbol_t next = lex_next_symbol();
+        symbol_t next = LEX_NEXT_SYMBOL();
         while (IS_LETTER(next) || IS_DIGIT(next) ||
                next == '_' || next == '$') {
             lex_accum_symbol(next);
             COMMIT()
-            next = lex_next_symbol();
+            next = LEX_NEXT_SYMBOL();
         }
-        size_t n_size = sizeof(symbol_t) * accum_symbols_size;
-        char *str_value = new char[n_size + 1];
-        bzero(str_value, n_size + 1);
-        memcpy(str_value, accum_buffer, n_size);
-        if (isKeyword()) {
+        token.keyword = lookup_keyword();
+        if (token.keyword) {
             token.type = TOKEN_KEYWORD;
         } else {
             token.type = TOKEN_IDENTIFIER;
         }
-        bzero(accum_buffer, n_size);
-        accum_symbols_size = 0;
-        token.ident_value = str_value;
+        token.ident_value = lex_take_accum<Policy>(&token, sizeof(symbol_t) * accum_symbols_size);
         return token;
     }
     if (IS_DIGIT(c1)) {
         // integer or float literal
-        lex_accum_symbol(c1);
+        LEX_ACCUM_PAYLOAD(c1)
         COMMIT()
         symbol_t s;
         goto skip_parse_float_literal;
@@ -348,27 +662,27 @@ token_t lex_next() {
         start_parse_float_literal:;
         // we have float literal
         // save it as string
-        s = lex_next_symbol();
+        s = LEX_NEXT_SYMBOL();
         do {
-            lex_accum_symbol(s);
+            LEX_ACCUM_PAYLOAD(s)
             COMMIT()
-            s = lex_next_symbol();
+            s = LEX_NEXT_SYMBOL();
             // check all allowed symbols in this literal
         } while (IS_DIGIT(s) || s == '.' ||
                  s == 'e' || s == 'E' || s == '-' || s == '+' ||
                  s == 'F' || s == 'f' || s == 'D' || s == 'd');
-        build_float_literal(&token, 0);
+        build_float_literal<Policy>(&token, 0);
         return token;
 
         skip_parse_float_literal:
         if (c1 == '0') {
             // check hex numeral case
-            symbol_t c2 = lex_next_symbol();
+            symbol_t c2 = LEX_NEXT_SYMBOL();
             if (c2 == 'x' || c2 == 'X') {
                 // integer hex literal for sure
-                lex_accum_symbol(c2);
+                LEX_ACCUM_PAYLOAD(c2)
                 COMMIT()
-                symbol_t hex_num = lex_next_symbol();
+                symbol_t hex_num = LEX_NEXT_SYMBOL();
                 // first symbol after x|X should be hex literal
                 if (!IS_HEX_DIGIT(hex_num)) {
                     REPORT_ERROR_WITH_POS("expected hex numeral")
@@ -376,59 +690,59 @@ token_t lex_next() {
                 }
                 // while we have hex numerals, process the input
                 do {
-                    lex_accum_symbol(hex_num);
+                    LEX_ACCUM_PAYLOAD(hex_num)
                     COMMIT()
-                    hex_num = lex_next_symbol();
+                    hex_num = LEX_NEXT_SYMBOL();
                 } while (IS_HEX_DIGIT(hex_num));
                 // return token
                 if (hex_num == 'l' || hex_num == 'L') {
                     // skip the l|L at the end
                     COMMIT()
                 }
-                build_integer_literal(&token, 1);
+                build_integer_literal<Policy>(&token, 1);
                 return token;
             } else {
                 if (IS_DIGIT(c2) || c2 == '.' ||
                     c2 == 'E' || c2 == 'e') {
-                    lex_accum_symbol(c2);
+                    LEX_ACCUM_PAYLOAD(c2)
                     COMMIT()
                     goto start_parse_float_literal;
                 }
                 if (c2 == 'l' || c2 == 'L') {
                     COMMIT()
                 }
-                build_integer_literal(&token, 0);
+                build_integer_literal<Policy>(&token, 0);
                 return token;
             }
         } else {
             // first digit is not a zero, we can accept any non-hex digits further
-            symbol_t hex_num = lex_next_symbol();
+            symbol_t hex_num = LEX_NEXT_SYMBOL();
             do {
-                lex_accum_symbol(hex_num);
+                LEX_ACCUM_PAYLOAD(hex_num)
                 COMMIT()
-                hex_num = lex_next_symbol();
+                hex_num = LEX_NEXT_SYMBOL();
             } while (IS_DIGIT(hex_num));
 
             if (hex_num == '.' || hex_num == 'E' || hex_num == 'e') {
-                lex_accum_symbol(hex_num);
+                LEX_ACCUM_PAYLOAD(hex_num)
                 COMMIT()
                 goto start_parse_float_literal;
             }
             if (hex_num == 'l' || hex_num == 'L') {
                 COMMIT()
             }
-            build_integer_literal(&token, 0);
+            build_integer_literal<Policy>(&token, 0);
             return token;
         }
     }
     if (c1 == '\'') {
         // character literal is expected
         COMMIT()
-        symbol_t c2 = lex_next_symbol();
+        symbol_t c2 = LEX_NEXT_SYMBOL();
         COMMIT()
         if (c2 == '\\') {
             // escape or unicode symbol
-            symbol_t c3 = lex_next_symbol();
+            symbol_t c3 = LEX_NEXT_SYMBOL();
             if (c3 == 'u') {
                 // unicode symbol
                 COMMIT_AND_SHIFT(u1)
@@ -454,7 +768,7 @@ token_t lex_next() {
         } else {
             token.char_value = c2;
         }
-        symbol_t last = lex_next_symbol();
+        symbol_t last = LEX_NEXT_SYMBOL();
         if (last != '\'') {
             REPORT_ERROR_WITH_POS(" closing single quote expected")
             return token;
@@ -466,43 +780,57 @@ token_t lex_next() {
     if (c1 == '"') {
         // string literal starting
         COMMIT()
-        symbol_t s = lex_next_symbol();
+        int64_t literal_start = input_symbols_ptr;
+        symbol_t s = LEX_NEXT_SYMBOL();
         if (s == '"') {
             // empty string or a multiline literal
             COMMIT_AND_SHIFT(s2)
             if (s2 == '"') {
                 // multiline literal
                 COMMIT()
-                s = lex_next_symbol();
+                literal_start = input_symbols_ptr;
+                s = LEX_NEXT_SYMBOL();
                 int counter = 0;
                 do {
-                    lex_accum_symbol(s);
+                    if (s == '\0') {
+                        break;
+                    }
+                    LEX_ACCUM_LITERAL(s)
                     if (s == '"') {
                         ++counter;
                     } else {
                         counter = 0;
                     }
                     COMMIT()
-                    s = lex_next_symbol();
+                    s = LEX_NEXT_SYMBOL();
                 } while (counter < 3);
-                build_string_literal(&token, 1);
+                if (counter < 3) {
+                    // the rest of the input is the literal
+                    REPORT_ERROR_WITH_POS("eof while reading multiline string literal")
+                    build_string_literal<Policy>(&token, 0, literal_start);
+                    return token;
+                }
+                build_string_literal<Policy>(&token, 1, literal_start);
             } else {
                 // empty string
-                build_string_literal(&token, 0);
+                build_string_literal<Policy>(&token, 0, input_symbols_ptr);
             }
         } else {
-            symbol_t prev = 0;
-            do {
-                lex_accum_symbol(s);
+            // a backslash escapes the next symbol only, so "\\" is closed by its second quote
+            bool escaped = false;
+            while (s != '\0' && s != '\n' && (s != '"' || escaped)) {
+                escaped = !escaped && s == '\\';
+                LEX_ACCUM_LITERAL(s)
                 COMMIT()
-                prev = s;
-                s = lex_next_symbol();
-                if (s == '"' && prev != '\\') {
-                    break;
-                }
-            } while (s != 0);
+                s = LEX_NEXT_SYMBOL();
+            }
+            build_string_literal<Policy>(&token, 0, literal_start);
+            if (s != '"') {
+                // the literal ends at the line end, the newline is the next token
+                REPORT_ERROR_WITH_POS("newline or eof while reading string literal")
+                return token;
+            }
             COMMIT()
-            build_string_literal(&token, 0);
         }
         return token;
     }
@@ -510,7 +838,11 @@ token_t lex_next() {
         token.type = TOKEN_DELIMITER;
         token.delim = DELIM_NEWLINE;
         COMMIT()
-        while (lex_next_symbol() == '\n') {
+        if (Policy::trivia) {
+            // keep blank lines
+            return token;
+        }
+        while (LEX_NEXT_SYMBOL() == '\n') {
             COMMIT()
         }
         return token;
@@ -555,11 +887,52 @@ token_t lex_next() {
 
     if (c1 == '\0') {
         token.type = TOKEN_EOF;
+    } else {
+        // consumed, so the caller may go on after it
+        token.type = TOKEN_UNKNOWN;
+        token.char_value = (uint8_t) c1;
+        COMMIT()
     }
     return token;
 }
 
+template<typename Policy>
+token_t lex_next_policy() {
+    PROFILE_SCOPE("lex_next")
+    // main function of the lexer
+    token_t token;
+    do {
+        token = lex_scan<Policy>();
+    } while (Policy::options && token.type != TOKEN_EOF && !lex_payload_wanted(token.type));
+    return token;
+}
+
+#define LEX_INSTANTIATE_POLICY(positions, trivia, payloads, options) \
+    template token_t lex_next_policy<lex_policy_t<positions, trivia, payloads, options>>();
+
+LEX_INSTANTIATE_POLICY(false, false, false, false)
+LEX_INSTANTIATE_POLICY(false, false, false, true)
+LEX_INSTANTIATE_POLICY(false, false, true, false)
+LEX_INSTANTIATE_POLICY(false, false, true, true)
+LEX_INSTANTIATE_POLICY(false, true, false, false)
+LEX_INSTANTIATE_POLICY(false, true, false, true)
+LEX_INSTANTIATE_POLICY(false, true, true, false)
+LEX_INSTANTIATE_POLICY(false, true, true, true)
+LEX_INSTANTIATE_POLICY(true, false, false, false)
+LEX_INSTANTIATE_POLICY(true, false, false, true)
+LEX_INSTANTIATE_POLICY(true, false, true, false)
+LEX_INSTANTIATE_POLICY(true, false, true, true)
+LEX_INSTANTIATE_POLICY(true, true, false, false)
+LEX_INSTANTIATE_POLICY(true, true, false, true)
+LEX_INSTANTIATE_POLICY(true, true, true, false)
+LEX_INSTANTIATE_POLICY(true, true, true, true)
+
+token_t lex_next() {
+    return lex_next_policy<lex_default_policy_t>();
+}
+
 char *token_to_string(token_t *token) {
+    PROFILE_SCOPE("token_to_string")
     char *buffer = nullptr;
     // Additional data to add
     // char* to_add 
@@ -570,13 +943,13 @@ char *token_to_string(token_t *token) {
         case TOKEN_IDENTIFIER: {
             char *ident = token->ident_value;
             token_name = strdup("ident");
-            token_val = strdup(ident);
+            token_val = strndup(ident, token->length);
             break;
         }
         case TOKEN_KEYWORD: {
             char *kw = token->ident_value;
             token_name = strdup("keyword");
-            token_val = strdup(kw);
+            token_val = strndup(kw, token->length);
             break;
         }
         case TOKEN_INT_LITERAL: {
@@ -589,7 +962,7 @@ char *token_to_string(token_t *token) {
         case TOKEN_FLOAT_LITERAL: {
             char *float_val = token->float_value;
             token_name = strdup("literal(float)");
-            token_val = strdup(float_val);
+            token_val = strndup(float_val, token->length);
             break;
         }
         case TOKEN_CHAR_LITERAL: {
@@ -617,7 +990,7 @@ char *token_to_string(token_t *token) {
         case TOKEN_STRING_LITERAL: {
             char *str = token->string_value;
             token_name = strdup("literal(string)");
-            token_val = strdup(str);
+            token_val = strndup(str, token->length);
             break;
         }
         case TOKEN_DELIMITER: {
@@ -671,6 +1044,12 @@ char *token_to_string(token_t *token) {
             }
             break;
         }
+        case TOKEN_UNKNOWN: {
+            token_name = strdup("unknown");
+            token_val = new char[8];
+            sprintf(token_val, "0x%02x", token->char_value);
+            break;
+        }
         case TOKEN_EOF: {
             return strdup("<eof>");
         }
@@ -679,7 +1058,7 @@ char *token_to_string(token_t *token) {
         }
     }
 
-    char token_template[] = "<%s=%s %d:%d>";
+    char token_template[] = "<%s=%s %u:%u>";
     buffer = new char[strlen(token_template) + strlen(token_name) + strlen(token_val) + 256];
     sprintf(buffer, token_template, token_name, token_val, token->line, token->offset);
     delete token_name;
@@ -688,11 +1067,18 @@ char *token_to_string(token_t *token) {
     return buffer;
 }
 
+template<typename Policy>
 int build_integer_literal(token_t *token, uint8_t is_hex) {
-    int32_t current = accum_symbols_size - 1;
+    PROFILE_SCOPE("build_integer_literal")
+    token->type = TOKEN_INT_LITERAL;
+    if (!lex_payload_built<Policy>(token->type)) {
+        accum_symbols_size = 0;
+        return 0;
+    }
+    int64_t current = accum_symbols_size - 1;
     uint32_t value = 0;
     uint32_t mul = 1;
-    int32_t end = is_hex ? 1 : -1;
+    int64_t end = is_hex ? 1 : -1;
     uint32_t mul_mul = is_hex ? 16 : 10;
     // read until the x|X expected at position 1
     while (current > end) {
@@ -702,33 +1088,41 @@ int build_integer_literal(token_t *token, uint8_t is_hex) {
         mul *= mul_mul;
         --current;
     }
-    bzero(accum_buffer, accum_symbols_size);
     accum_symbols_size = 0;
-    token->type = TOKEN_INT_LITERAL;
     token->int_value = value;
     return 0;
 }
 
+template<typename Policy>
 int build_float_literal(token_t *token, uint8_t is_double) {
-    size_t n_size = sizeof(symbol_t) * accum_symbols_size;
-    char *float_value = new char[n_size + 1];
-    bzero(float_value, n_size + 1);
-    memcpy(float_value, accum_buffer, n_size);
-    bzero(accum_buffer, n_size);
-    accum_symbols_size = 0;
+    PROFILE_SCOPE("build_float_literal")
     token->type = TOKEN_FLOAT_LITERAL;
-    token->float_value = float_value;
+    token->float_value = lex_take_accum<Policy>(token, sizeof(symbol_t) * accum_symbols_size);
     return 0;
 }
 
-int build_string_literal(token_t *token, uint8_t has_trailing_quotes) {
-    size_t n_size = sizeof(symbol_t) * (accum_symbols_size - (has_trailing_quotes ? 3 : 0));
-    char *str_value = new char[n_size + 1];
-    bzero(str_value, n_size + 1);
-    memcpy(str_value, accum_buffer, n_size);
-    bzero(accum_buffer, n_size);
-    accum_symbols_size = 0;
-    token->type = TOKEN_STRING_LITERAL;
-    token->float_value = str_value;
+template<typename Policy>
+int build_string_literal(token_t *token, uint8_t has_trailing_quotes, int64_t literal_start) {
+    PROFILE_SCOPE("build_string_literal")
+    return build_slice<Policy>(token, TOKEN_STRING_LITERAL, has_trailing_quotes ? 3 : 0, literal_start);
+}
+
+/**
+ * Builds the payload of string-like token, which ends at the current symbol
+ * @param type Type of the token
+ * @param trailing_size Count of trailing symbols, which are not a part of the payload
+ * @param slice_start Position of the payload in the mapped input
+ */
+template<typename Policy>
+int build_slice(token_t *token, uint8_t type, int64_t trailing_size, int64_t slice_start) {
+    token->type = type;
+    if (Policy::payloads && input_mapped) {
+        // slice the literal from the mapped input, no copying
+        token->string_value = (char *) (lex_buffer + slice_start);
+        token->length = lex_token_length((uint64_t) (input_symbols_ptr - slice_start - trailing_size));
+        return 0;
+    }
+    size_t n_size = sizeof(symbol_t) * (accum_symbols_size - (Policy::payloads ? trailing_size : 0));
+    token->string_value = lex_take_accum<Policy>(token, n_size);
     return 0;
 }
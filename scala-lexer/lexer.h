@@ -6,13 +6,15 @@
 #define CC_LABS_LEXER_H
 
 #include <cstdint>
+#include <cstdio>
 
 /// Identifier token
 /// Contains char *ident_value
+/// Operator identifiers also contain uint32_t oper, OP_* code or 0 for user-defined operators
 #define TOKEN_IDENTIFIER 1U
 
 /// Keyword token
-/// Contains uint32_t keyword
+/// Contains uint32_t keyword and char *ident_value
 #define TOKEN_KEYWORD 2U
 
 #define TOKEN_DELIMITER 4U
@@ -30,14 +32,34 @@
 #define TOKEN_FLOAT_LITERAL 10U
 
 /// String literal
-/// Contains char *string_value;
+/// Contains char *string_value of uint32_t length
+/// If the input is a buffer (see lex_input_buffer()), string_value points into it and is not null-terminated
 #define TOKEN_STRING_LITERAL 11U
 
 /// Char literal
 #define TOKEN_CHAR_LITERAL  12U
 
+/// Whitespace trivia, returned only by the lexer cores with trivia policy
+/// Contains char *string_value of uint32_t length
+#define TOKEN_WHITESPACE    13U
+
+/// Comment trivia including its delimiters, returned only by the lexer cores with trivia policy
+/// Contains char *string_value of uint32_t length
+#define TOKEN_COMMENT       14U
+
+/// Symbol which does not start any token, such as @ or a non-ASCII byte, it is skipped
+/// Contains uint32_t char_value
+#define TOKEN_UNKNOWN       15U
+
 #define TOKEN_EOF            255U
 
+/// Bit of the token type in the filter mask, see lex_set_filter()
+#define TOKEN_MASK(type)     (1U << ((type) & 31U))
+#define TOKEN_MASK_ALL       0xffffffffU
+
+/// Token payload was not copied yet, see lex_set_lazy_payload()
+#define TOKEN_FLAG_LAZY      0x01U
+
 /// boolean type
 typedef int bool_t;
 
@@ -51,6 +73,9 @@ typedef char symbol_t;
  */
 typedef struct {
     uint8_t type;
+    uint8_t flags;
+    /// payload length of identifier, keyword, float and string tokens
+    uint32_t length;
     union {
         uint32_t keyword;
         uint32_t oper;
@@ -62,8 +87,11 @@ typedef struct {
         char *string_value;
     };
     char *ident_value;
-    int line;
-    int offset;
+    /// absolute position of the first symbol of the token in the input, inputs may exceed 4 GiB
+    uint64_t pos;
+    uint32_t line;
+    /// column of the first symbol, saturated at UINT32_MAX on longer lines
+    uint32_t offset;
 } token_t;
 
 /**
@@ -72,6 +100,48 @@ typedef struct {
  */
 void lex_input(FILE *input_desc);
 
+/**
+ * Resets the lexer state of the calling thread, so the next input could be lexed from its beginning
+ * Lexer state is thread local, each thread lexes its own input
+ */
+void lex_reset();
+
+/**
+ * Sets the whole input to the given buffer, e.g. mmap'd file
+ * The buffer is never copied and should outlive all tokens, since string literals are sliced from it
+ * @param buffer input symbols
+ * @param size count of symbols in the buffer
+ */
+void lex_input_buffer(const symbol_t *buffer, size_t size);
+
+/**
+ * Moves the lexer to the given position of the buffer set by lex_input_buffer(), does nothing for streams
+ * Skipped symbols are not lexed, only newlines are counted to keep line numbers
+ * @param pos Position in the buffer
+ */
+void lex_seek(size_t pos);
+
+/**
+ * Sets kinds of tokens returned by lex_next()
+ * Other tokens are skipped and their payload is never built, TOKEN_EOF is always returned
+ * @param mask bitwise or of TOKEN_MASK(type), TOKEN_MASK_ALL by default
+ */
+void lex_set_filter(uint32_t mask);
+
+/**
+ * Enables lazy payloads: identifier, keyword, float and string payloads are not copied by lex_next(),
+ * the token is marked with TOKEN_FLAG_LAZY and points to the lexer buffer, which is valid until the next lex_next()
+ * @param lazy true to enable lazy payloads
+ */
+void lex_set_lazy_payload(bool_t lazy);
+
+/**
+ * Copies the payload of the lazy token to a new buffer, does nothing for other tokens
+ * Should be called before the next lex_next(), if the payload is needed
+ * @param token Token returned by lex_next()
+ */
+void lex_materialize(token_t *token);
+
 /**
  * On demand returns next token extracted from the input stream, char by char obtained via lex_next_symbol()
  * Requiring the next char of the input stream will return the next char after the last one of the token
@@ -82,6 +152,41 @@ token_t lex_next();
 
 void on_lex_error(const char *error_desc);
 
+/**
+ * Compile-time features of the lexer core
+ * Each policy gets its own specialized lexing loop without runtime checks of disabled features
+ * @tparam Positions fill pos, line and offset of the tokens
+ * @tparam Trivia return whitespaces and comments as TOKEN_WHITESPACE and TOKEN_COMMENT tokens,
+ *                consecutive newlines are not merged
+ * @tparam Payloads build token payloads, otherwise only kinds and keyword codes are returned
+ * @tparam Options honor lex_set_filter() and lex_set_lazy_payload()
+ */
+template<bool Positions, bool Trivia, bool Payloads, bool Options>
+struct lex_policy_t {
+    static constexpr bool positions = Positions;
+    static constexpr bool trivia = Trivia;
+    static constexpr bool payloads = Payloads;
+    static constexpr bool options = Options;
+};
+
+/// policy of lex_next()
+typedef lex_policy_t<true, false, true, true> lex_default_policy_t;
+
+/// token kinds only
+typedef lex_policy_t<false, false, false, false> lex_kinds_policy_t;
+
+/// every symbol of the input belongs to some token, e.g. for formatters
+typedef lex_policy_t<true, true, true, false> lex_trivia_policy_t;
+
+/**
+ * Same as lex_next(), but lexed by the core specialized for the policy
+ * Cores for all lex_policy_t combinations are instantiated in lexer.cpp
+ * @tparam Policy lex_policy_t
+ * @return next token
+ */
+template<typename Policy>
+token_t lex_next_policy();
+
 /**
  * String representation of the token
  * @param token Token to be represented as a string
@@ -89,8 +194,56 @@ void on_lex_error(const char *error_desc);
  */
 char *token_to_string(token_t *token);
 
-//TODO: add other keywords and fix numbers
-#define KEYWORD_IF      0x00000001U
+#define KEYWORD_ABSTRACT    0x00000001U
+#define KEYWORD_CASE        0x00000002U
+#define KEYWORD_CATCH       0x00000003U
+#define KEYWORD_CLASS       0x00000004U
+#define KEYWORD_DEF         0x00000005U
+#define KEYWORD_DO          0x00000006U
+#define KEYWORD_ELSE        0x00000007U
+#define KEYWORD_EXTENDS     0x00000008U
+#define KEYWORD_FALSE       0x00000009U
+#define KEYWORD_FINAL       0x0000000aU
+#define KEYWORD_FINALLY     0x0000000bU
+#define KEYWORD_FOR         0x0000000cU
+#define KEYWORD_FOR_SOME    0x0000000dU
+#define KEYWORD_IF          0x0000000eU
+#define KEYWORD_IMPLICIT    0x0000000fU
+#define KEYWORD_IMPORT      0x00000010U
+#define KEYWORD_LAZY        0x00000011U
+#define KEYWORD_MACRO       0x00000012U
+#define KEYWORD_MATCH       0x00000013U
+#define KEYWORD_NEW         0x00000014U
+#define KEYWORD_NULL        0x00000015U
+#define KEYWORD_OBJECT      0x00000016U
+#define KEYWORD_OVERRIDE    0x00000017U
+#define KEYWORD_PACKAGE     0x00000018U
+#define KEYWORD_PRIVATE     0x00000019U
+#define KEYWORD_PROTECTED   0x0000001aU
+#define KEYWORD_RETURN      0x0000001bU
+#define KEYWORD_SEALED      0x0000001cU
+#define KEYWORD_SUPER       0x0000001dU
+#define KEYWORD_THIS        0x0000001eU
+#define KEYWORD_THROW       0x0000001fU
+#define KEYWORD_TRAIT       0x00000020U
+#define KEYWORD_TRY         0x00000021U
+#define KEYWORD_TRUE        0x00000022U
+#define KEYWORD_TYPE        0x00000023U
+#define KEYWORD_VAL         0x00000024U
+#define KEYWORD_VAR         0x00000025U
+#define KEYWORD_WHILE       0x00000026U
+#define KEYWORD_WITH        0x00000027U
+#define KEYWORD_YIELD       0x00000028U
+#define KEYWORD_UNDERSCORE  0x00000029U //  _
+#define KEYWORD_COLON       0x0000002aU //  :
+#define KEYWORD_ASSIGN      0x0000002bU //  =
+#define KEYWORD_ARROW       0x0000002cU // =>
+#define KEYWORD_LARROW      0x0000002dU // <-
+#define KEYWORD_UPPER_BOUND 0x0000002eU // <:
+#define KEYWORD_VIEW_BOUND  0x0000002fU // <%
+#define KEYWORD_LOWER_BOUND 0x00000030U // >:
+#define KEYWORD_HASH        0x00000031U //  #
+#define KEYWORD_AT          0x00000032U //  @
 
 #define DELIM_NEWLINE       0x00000001U
 #define DELIM_BRACE_OPEN    0x00000002U
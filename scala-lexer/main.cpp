@@ -2,23 +2,343 @@
 // Created by Ilya Potemin on 9/2/19.
 //
 
+#include <algorithm>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+#include "bundle.h"
+#include "clones.h"
+#include "count.h"
+#include "files.h"
 #include "lexer.h"
+#include "server.h"
+#include "structure.h"
+#include "token_store.h"
+#include "watch.h"
 
 void on_lex_error(const char *error_desc) {
     fprintf(stderr, "%s\n", error_desc);
 }
 
+/**
+ * Maps the file into memory and passes it to the lexer as a buffer
+ * @param file Mapping, owned by the caller, which unmaps it after the last token of the file
+ * @return true, if the file was mapped
+ */
+bool lex_map_file(const char *file_name, mapped_file_t *file) {
+    if (!map_file(file_name, file)) {
+        return false;
+    }
+    lex_input_buffer(file->data, file->size);
+    return true;
+}
+
+/**
+ * scala_lex --clones [-k <window tokens>] [-w <winnow size>] [-m <max fingerprints>] <source dir or file>...
+ */
+int clones_main(int argc, const char **argv) {
+    clones_config_t config{CLONES_DEFAULT_WINDOW_TOKENS, CLONES_DEFAULT_WINNOW_SIZE,
+                           CLONES_DEFAULT_MAX_FINGERPRINTS};
+    std::vector<std::string> paths;
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "-k") == 0 && i + 1 < argc) {
+            config.window_tokens = (size_t) atol(argv[++i]);
+        } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            config.winnow_size = (size_t) atol(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            config.max_fingerprints = (size_t) atol(argv[++i]);
+        } else {
+            collect_source_files(argv[i], paths);
+        }
+    }
+    if (config.window_tokens == 0 || config.winnow_size == 0) {
+        printf("Window sizes should be positive\n");
+        return 1;
+    }
+    std::sort(paths.begin(), paths.end());
+    size_t regions = clones_report(paths, &config, stdout);
+    fprintf(stderr, "%zu duplicate regions in %zu files\n", regions, paths.size());
+    return 0;
+}
+
+/**
+ * scala_lex --outline [-d <max depth>] <source dir or file>...
+ */
+int outline_main(int argc, const char **argv) {
+    int max_depth = 0;
+    std::vector<std::string> paths;
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            max_depth = atoi(argv[++i]);
+        } else {
+            collect_source_files(argv[i], paths);
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    for (auto &path : paths) {
+        printf("%s\n", path.c_str());
+        if (structure_outline(path.c_str(), max_depth, stdout) < 0) {
+            printf("Unable to open file %s\n", path.c_str());
+        }
+    }
+    return 0;
+}
+
+/**
+ * scala_lex --serve <socket> [-j <workers>] [-c <cache bytes>]
+ * scala_lex --client <socket> <file>
+ */
+int server_main(int argc, const char **argv) {
+    if (strcmp(argv[1], "--client") == 0) {
+        if (argc != 4) {
+            printf("Usage: scala_lex --client <socket> <file>\n");
+            return 1;
+        }
+        return server_client(argv[2], argv[3]);
+    }
+    server_config_t config{nullptr, SERVER_DEFAULT_WORKERS, SERVER_DEFAULT_CACHE_SIZE,
+                           SERVER_DEFAULT_IDLE_TIMEOUT, SERVER_DEFAULT_MAX_STRINGS};
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            config.worker_count = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            config.cache_size = (size_t) atoll(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            config.idle_timeout = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            config.max_strings = (size_t) atoll(argv[++i]);
+        } else {
+            config.socket_path = argv[i];
+        }
+    }
+    if (config.socket_path == nullptr) {
+        printf("Usage: scala_lex --serve <socket> [-j <workers>] [-c <cache bytes>] [-t <idle seconds>] "
+               "[-s <max strings>]\n");
+        return 1;
+    }
+    return server_run(&config);
+}
+
+/**
+ * scala_lex --watch <source dir>
+ */
+int watch_main(int argc, const char **argv) {
+    if (argc != 3) {
+        printf("Usage: scala_lex --watch <source dir>\n");
+        return 1;
+    }
+    return watch_run(argv[2]);
+}
+
+/// position and kind of a stored token, kept by --check to compare with the decoded ones
+typedef struct {
+    uint64_t pos;
+    uint32_t line;
+    uint32_t offset;
+    uint8_t type;
+    uint32_t code;
+} stored_token_t;
+
+static stored_token_t stored_token_of(const token_t *token) {
+    return {token->pos, token->line, token->offset, token->type,
+            token->type == TOKEN_DELIMITER ? token->delim : 0};
+}
+
+static bool stored_token_equal(const stored_token_t &x, const stored_token_t &y) {
+    return x.pos == y.pos && x.line == y.line && x.offset == y.offset && x.type == y.type && x.code == y.code;
+}
+
+/**
+ * Decodes every token of the store both sequentially and by seeking to it
+ * @return count of tokens which differ from the appended ones
+ */
+static size_t store_check(const token_store_t *store, const std::vector<stored_token_t> &expected) {
+    size_t mismatches = 0;
+    token_store_cursor_t cursor = token_store_seek(store, 0);
+    for (size_t index = 0; index < expected.size(); ++index) {
+        token_t token;
+        token_store_cursor_t seek = token_store_seek(store, index);
+        token_t sought;
+        if (!token_store_next(&cursor, &token) || !token_store_next(&seek, &sought)) {
+            return mismatches + expected.size() - index;
+        }
+        stored_token_t decoded = stored_token_of(&token);
+        stored_token_t found = stored_token_of(&sought);
+        if (!stored_token_equal(decoded, expected[index]) || !stored_token_equal(found, expected[index])) {
+            if (mismatches == 0) {
+                printf("token %zu: expected %u at %llu %u:%u, decoded %u at %llu %u:%u\n", index,
+                       expected[index].type, (unsigned long long) expected[index].pos, expected[index].line,
+                       expected[index].offset, decoded.type, (unsigned long long) decoded.pos, decoded.line,
+                       decoded.offset);
+            }
+            ++mismatches;
+        }
+    }
+    return mismatches;
+}
+
+/**
+ * scala_lex --store [--check] [-p <token index>]... <source dir or file>...
+ */
+int store_main(int argc, const char **argv) {
+    std::vector<size_t> printed;
+    std::vector<std::string> paths;
+    bool check = false;
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            printed.push_back((size_t) atoll(argv[++i]));
+        } else if (strcmp(argv[i], "--check") == 0) {
+            check = true;
+        } else {
+            collect_source_files(argv[i], paths);
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    token_store_t store{};
+    std::vector<stored_token_t> expected;
+    lex_set_lazy_payload(1);
+    for (auto &path : paths) {
+        token_store_begin_file(&store);
+        lex_reset();
+        mapped_file_t file{};
+        if (!lex_map_file(path.c_str(), &file)) {
+            struct stat info{};
+            if (stat(path.c_str(), &info) != 0 || info.st_size > 0) {
+                fprintf(stderr, "Unable to map file %s\n", path.c_str());
+            }
+            continue;
+        }
+        token_t token;
+        do {
+            token = lex_next();
+            token_store_append(&store, &token);
+            if (check && token.type != TOKEN_EOF) {
+                expected.push_back(stored_token_of(&token));
+            }
+        } while (token.type != TOKEN_EOF);
+        // the payloads are interned by the store, nothing points into the mapping
+        unmap_file(&file);
+    }
+    lex_set_lazy_payload(0);
+    token_store_seal(&store);
+    size_t count = token_store_size(&store);
+    size_t memory = token_store_memory(&store);
+    printf("%zu tokens in %zu files, %zu bytes, %.2f bytes per token (token_t is %zu bytes)\n",
+           count, paths.size(), memory, count > 0 ? (double) memory / (double) count : 0.0, sizeof(token_t));
+    if (check) {
+        size_t mismatches = store_check(&store, expected);
+        printf("check: %zu of %zu tokens differ\n", mismatches, expected.size());
+        if (mismatches > 0) {
+            return 1;
+        }
+    }
+    for (size_t index : printed) {
+        token_store_cursor_t cursor = token_store_seek(&store, index);
+        token_t token;
+        if (!token_store_next(&cursor, &token)) {
+            printf("%zu: out of range\n", index);
+            continue;
+        }
+        char *tok_str = token_to_string(&token);
+        printf("%zu: %s %s\n", index, paths[token_store_file_of(&store, index)].c_str(), tok_str);
+        free(tok_str);
+    }
+    return 0;
+}
+
+/**
+ * scala_lex --bundle <bundle file> [-j <threads>]
+ */
+int bundle_main(int argc, const char **argv) {
+    int thread_count = 0;
+    const char *bundle_path = nullptr;
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            thread_count = atoi(argv[++i]);
+        } else {
+            bundle_path = argv[i];
+        }
+    }
+    bundle_t bundle{};
+    if (bundle_path == nullptr || bundle_open(&bundle, bundle_path) != 0) {
+        printf("Unable to open bundle %s\n", bundle_path == nullptr ? "" : bundle_path);
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    size_t token_count = bundle_lex(&bundle, thread_count, stdout);
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+    fprintf(stderr, "%zu tokens in %u files, %lld us\n", token_count, bundle.header->entry_count,
+            (long long) elapsed.count());
+    bundle_close(&bundle);
+    return 0;
+}
+
+/**
+ * scala_lex --count [-j <threads>] <source dir or file>...
+ */
+int count_main(int argc, const char **argv) {
+    int thread_count = 0;
+    std::vector<std::string> roots;
+    std::vector<std::string> paths;
+    for (int i = 2; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            thread_count = atoi(argv[++i]);
+        } else {
+            std::string root(argv[i]);
+            while (root.size() > 1 && root.back() == '/') {
+                root.pop_back();
+            }
+            collect_source_files(root.c_str(), paths);
+            roots.push_back(root);
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    auto start = std::chrono::steady_clock::now();
+    count_report(roots, paths, thread_count, stdout);
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+    fprintf(stderr, "%zu files, %lld us\n", paths.size(), (long long) elapsed.count());
+    return 0;
+}
+
 int main(int argc, const char **argv) {
+    if (argc > 1 && strcmp(argv[1], "--clones") == 0) {
+        return clones_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--count") == 0) {
+        return count_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--outline") == 0) {
+        return outline_main(argc, argv);
+    }
+    if (argc > 1 && (strcmp(argv[1], "--serve") == 0 || strcmp(argv[1], "--client") == 0)) {
+        return server_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bundle") == 0) {
+        return bundle_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--store") == 0) {
+        return store_main(argc, argv);
+    }
+    if (argc > 1 && strcmp(argv[1], "--watch") == 0) {
+        return watch_main(argc, argv);
+    }
     //TODO: call lexer with test data
+    mapped_file_t file{};
     if (argc > 1) {
-        FILE *file = fopen(argv[1], "rb");
-        if (file) {
-            lex_input(file);
+        if (lex_map_file(argv[1], &file)) {
             printf("Reading file %s\n", argv[1]);
         } else {
-            printf("Unable to open file %s\n", argv[1]);
+            FILE *file = fopen(argv[1], "rb");
+            if (file) {
+                lex_input(file);
+                printf("Reading file %s\n", argv[1]);
+            } else {
+                printf("Unable to open file %s\n", argv[1]);
+            }
         }
     }
     token_t token;
@@ -28,6 +348,7 @@ int main(int argc, const char **argv) {
         printf("%s \n", tok_str);
         free(tok_str);
 
-    } while (token.type != TOKEN_EOF && token.type);
+    } while (token.type != TOKEN_EOF);
+    unmap_file(&file);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,24 @@
+//
+// scala_pack: packs source files into a bundle
+//
+
+#include <cstdio>
+#include "bundle.h"
+#include "lexer.h"
+
+void on_lex_error(const char *error_desc) {
+    fprintf(stderr, "%s\n", error_desc);
+}
+
+int main(int argc, const char **argv) {
+    if (argc < 3) {
+        printf("Usage: scala_pack <bundle file> <source dir or file>...\n");
+        return 1;
+    }
+    int packed = bundle_pack(argv[1], argv + 2, argc - 2);
+    if (packed < 0) {
+        return 1;
+    }
+    fprintf(stderr, "%d files packed into %s\n", packed, argv[1]);
+    return 0;
+}
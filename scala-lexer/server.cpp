@@ -0,0 +1,358 @@
+//
+// Persistent lexer daemon over a Unix domain socket
+//
+
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+#include "files.h"
+#include "lexer.h"
+#include "server.h"
+
+/// requests larger than this are rejected
+#define SERVER_MAX_REQUEST_LENGTH (1U << 30U)
+
+typedef std::shared_ptr<const std::vector<uint8_t>> response_ptr_t;
+
+/// identifier intern table shared by all workers
+static struct {
+    std::mutex mutex;
+    std::unordered_map<std::string, uint32_t> ids;
+    size_t limit;
+} intern_table;
+
+/// encoded responses by content hash, evicted in insertion order
+static struct {
+    std::mutex mutex;
+    std::unordered_map<uint64_t, response_ptr_t> entries;
+    std::deque<uint64_t> order;
+    size_t size;
+    size_t limit;
+} token_cache;
+
+/// accepted connections waiting for a worker
+static struct {
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<int> fds;
+    size_t limit;
+    timeval idle_timeout;
+} connection_queue;
+
+static bool read_full(int fd, void *buffer, size_t size) {
+    auto ptr = (uint8_t *) buffer;
+    while (size > 0) {
+        ssize_t count = read(fd, ptr, size);
+        if (count <= 0) {
+            return false;
+        }
+        ptr += count;
+        size -= (size_t) count;
+    }
+    return true;
+}
+
+static bool write_full(int fd, const void *buffer, size_t size) {
+    auto ptr = (const uint8_t *) buffer;
+    while (size > 0) {
+        ssize_t count = write(fd, ptr, size);
+        if (count <= 0) {
+            return false;
+        }
+        ptr += count;
+        size -= (size_t) count;
+    }
+    return true;
+}
+
+static inline bool has_string_payload(uint8_t type) {
+    return type == TOKEN_IDENTIFIER || type == TOKEN_KEYWORD ||
+           type == TOKEN_FLOAT_LITERAL || type == TOKEN_STRING_LITERAL;
+}
+
+/**
+ * Lexes the source and encodes the response
+ * Payload strings are collected per response first, so the intern table is locked once
+ */
+static response_ptr_t lex_response(const symbol_t *data, size_t size) {
+    std::vector<server_token_t> tokens;
+    std::vector<std::string> strings;
+    std::unordered_map<std::string, uint32_t> local_ids;
+
+    lex_reset();
+    lex_set_lazy_payload(1);
+    lex_input_buffer(data, size);
+    token_t token;
+    do {
+        token = lex_next();
+        server_token_t record{};
+        record.type = token.type;
+        record.pos = token.pos;
+        record.line = token.line;
+        record.offset = token.offset;
+        if (has_string_payload(token.type)) {
+            const char *payload = token.type == TOKEN_IDENTIFIER || token.type == TOKEN_KEYWORD ?
+                                  token.ident_value : token.string_value;
+            if (token.type == TOKEN_KEYWORD) {
+                record.code = (uint16_t) token.keyword;
+            } else if (token.type == TOKEN_IDENTIFIER) {
+                record.code = (uint16_t) token.oper;
+            }
+            std::string value = payload == nullptr ? std::string() : std::string(payload, token.length);
+            auto inserted = local_ids.emplace(std::move(value), (uint32_t) strings.size());
+            if (inserted.second) {
+                strings.push_back(inserted.first->first);
+            }
+            record.value = inserted.first->second;
+        } else if (token.type == TOKEN_BOOL_LITERAL) {
+            record.value = (uint32_t) token.bool_value;
+        } else if (token.type == TOKEN_INT_LITERAL) {
+            record.value = token.int_value;
+        } else if (token.type == TOKEN_CHAR_LITERAL || token.type == TOKEN_UNKNOWN) {
+            record.value = token.char_value;
+        } else if (token.type == TOKEN_DELIMITER) {
+            record.value = token.delim;
+        }
+        tokens.push_back(record);
+    } while (token.type != TOKEN_EOF);
+
+    std::vector<uint32_t> global_ids(strings.size());
+    {
+        std::lock_guard<std::mutex> lock(intern_table.mutex);
+        if (intern_table.ids.size() + strings.size() > intern_table.limit) {
+            // cached responses refer to the old ids, so they are dropped too
+            std::unordered_map<std::string, uint32_t>().swap(intern_table.ids);
+            std::lock_guard<std::mutex> cache_lock(token_cache.mutex);
+            token_cache.entries.clear();
+            token_cache.order.clear();
+            token_cache.size = 0;
+        }
+        for (size_t i = 0; i < strings.size(); ++i) {
+            auto inserted = intern_table.ids.emplace(strings[i], (uint32_t) intern_table.ids.size());
+            global_ids[i] = inserted.first->second;
+        }
+    }
+
+    size_t strings_size = 0;
+    for (auto &string : strings) {
+        strings_size += 2 * sizeof(uint32_t) + string.size();
+    }
+    auto response = std::make_shared<std::vector<uint8_t>>(
+            sizeof(server_response_t) + sizeof(server_token_t) * tokens.size() + strings_size);
+    uint8_t *out = response->data();
+    server_response_t header{SERVER_RESPONSE_MAGIC, SERVER_STATUS_OK,
+                             (uint32_t) tokens.size(), (uint32_t) strings.size()};
+    memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    for (auto &record : tokens) {
+        if (has_string_payload(record.type)) {
+            record.value = global_ids[record.value];
+        }
+    }
+    memcpy(out, tokens.data(), sizeof(server_token_t) * tokens.size());
+    out += sizeof(server_token_t) * tokens.size();
+    for (size_t i = 0; i < strings.size(); ++i) {
+        uint32_t string_header[2] = {global_ids[i], (uint32_t) strings[i].size()};
+        memcpy(out, string_header, sizeof(string_header));
+        out += sizeof(string_header);
+        memcpy(out, strings[i].data(), strings[i].size());
+        out += strings[i].size();
+    }
+    return response;
+}
+
+/// returns cached response for the source or lexes it
+static response_ptr_t cached_response(const symbol_t *data, size_t size) {
+    uint64_t hash = hash_content(data, size);
+    {
+        std::lock_guard<std::mutex> lock(token_cache.mutex);
+        auto found = token_cache.entries.find(hash);
+        if (found != token_cache.entries.end()) {
+            return found->second;
+        }
+    }
+    response_ptr_t response = lex_response(data, size);
+    std::lock_guard<std::mutex> lock(token_cache.mutex);
+    if (response->size() <= token_cache.limit && token_cache.entries.emplace(hash, response).second) {
+        token_cache.order.push_back(hash);
+        token_cache.size += response->size();
+        while (token_cache.size > token_cache.limit) {
+            auto evicted = token_cache.entries.find(token_cache.order.front());
+            token_cache.size -= evicted->second->size();
+            token_cache.entries.erase(evicted);
+            token_cache.order.pop_front();
+        }
+    }
+    return response;
+}
+
+static bool send_error(int fd) {
+    server_response_t header{SERVER_RESPONSE_MAGIC, SERVER_STATUS_ERROR, 0, 0};
+    return write_full(fd, &header, sizeof(header));
+}
+
+/// serves requests of the connection until it is closed or stays idle for the timeout
+static void serve_connection(int fd) {
+    // a failed read or write closes the connection, so a silent client does not hold the worker
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &connection_queue.idle_timeout, sizeof(timeval));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &connection_queue.idle_timeout, sizeof(timeval));
+    std::vector<symbol_t> payload;
+    server_request_t request{};
+    while (read_full(fd, &request, sizeof(request))) {
+        if (request.magic != SERVER_REQUEST_MAGIC || request.length > SERVER_MAX_REQUEST_LENGTH) {
+            send_error(fd);
+            break;
+        }
+        payload.resize(request.length);
+        if (!read_full(fd, payload.data(), request.length)) {
+            break;
+        }
+        response_ptr_t response;
+        if (request.kind == SERVER_REQUEST_BUFFER) {
+            response = cached_response(payload.data(), payload.size());
+        } else if (request.kind == SERVER_REQUEST_PATH) {
+            std::string path(payload.data(), payload.size());
+            mapped_file_t file{};
+            if (map_file(path.c_str(), &file)) {
+                response = cached_response(file.data, file.size);
+                unmap_file(&file);
+            } else if (access(path.c_str(), R_OK) == 0) {
+                // empty files are not mapped
+                response = cached_response(nullptr, 0);
+            }
+        }
+        if (response == nullptr ? !send_error(fd) : !write_full(fd, response->data(), response->size())) {
+            break;
+        }
+    }
+    close(fd);
+}
+
+static void worker_loop() {
+    while (true) {
+        int fd;
+        {
+            std::unique_lock<std::mutex> lock(connection_queue.mutex);
+            connection_queue.not_empty.wait(lock, [] { return !connection_queue.fds.empty(); });
+            fd = connection_queue.fds.front();
+            connection_queue.fds.pop_front();
+        }
+        connection_queue.not_full.notify_one();
+        serve_connection(fd);
+    }
+}
+
+static int connect_socket(const char *socket_path, bool listening) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path is too long: %s\n", socket_path);
+        return -1;
+    }
+    strcpy(address.sun_path, socket_path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int result;
+    if (listening) {
+        unlink(socket_path);
+        result = bind(fd, (sockaddr *) &address, sizeof(address));
+        if (result == 0) {
+            result = listen(fd, 64);
+        }
+    } else {
+        result = connect(fd, (sockaddr *) &address, sizeof(address));
+    }
+    if (result != 0) {
+        perror(socket_path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int server_run(const server_config_t *config) {
+    signal(SIGPIPE, SIG_IGN);
+    int listen_fd = connect_socket(config->socket_path, true);
+    if (listen_fd < 0) {
+        return 1;
+    }
+    token_cache.limit = config->cache_size;
+    intern_table.limit = config->max_strings > 0 ? config->max_strings : SERVER_DEFAULT_MAX_STRINGS;
+    connection_queue.idle_timeout.tv_sec = config->idle_timeout > 0 ? config->idle_timeout :
+                                           SERVER_DEFAULT_IDLE_TIMEOUT;
+    int worker_count = config->worker_count > 0 ? config->worker_count : SERVER_DEFAULT_WORKERS;
+    connection_queue.limit = (size_t) worker_count * 4;
+    for (int i = 0; i < worker_count; ++i) {
+        std::thread(worker_loop).detach();
+    }
+    fprintf(stderr, "Serving on %s with %d workers\n", config->socket_path, worker_count);
+    while (true) {
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(connection_queue.mutex);
+        connection_queue.not_full.wait(lock, [] { return connection_queue.fds.size() < connection_queue.limit; });
+        connection_queue.fds.push_back(fd);
+        lock.unlock();
+        connection_queue.not_empty.notify_one();
+    }
+}
+
+int server_client(const char *socket_path, const char *file_path) {
+    int fd = connect_socket(socket_path, false);
+    if (fd < 0) {
+        return 1;
+    }
+    server_request_t request{SERVER_REQUEST_MAGIC, SERVER_REQUEST_PATH, (uint32_t) strlen(file_path)};
+    server_response_t response{};
+    if (!write_full(fd, &request, sizeof(request)) || !write_full(fd, file_path, request.length) ||
+        !read_full(fd, &response, sizeof(response)) || response.magic != SERVER_RESPONSE_MAGIC) {
+        fprintf(stderr, "Unable to communicate with %s\n", socket_path);
+        close(fd);
+        return 1;
+    }
+    if (response.status != SERVER_STATUS_OK) {
+        fprintf(stderr, "Request failed\n");
+        close(fd);
+        return 1;
+    }
+    std::vector<server_token_t> tokens(response.token_count);
+    bool ok = read_full(fd, tokens.data(), sizeof(server_token_t) * tokens.size());
+    std::unordered_map<uint32_t, std::string> strings;
+    for (uint32_t i = 0; ok && i < response.string_count; ++i) {
+        uint32_t string_header[2];
+        ok = read_full(fd, string_header, sizeof(string_header));
+        std::string value(string_header[1], '\0');
+        ok = ok && read_full(fd, &value[0], value.size());
+        strings[string_header[0]] = value;
+    }
+    close(fd);
+    if (!ok) {
+        fprintf(stderr, "Truncated response\n");
+        return 1;
+    }
+    for (auto &token : tokens) {
+        if (has_string_payload(token.type)) {
+            printf("<%u %s %u:%u>\n", token.type, strings[token.value].c_str(), token.line, token.offset);
+        } else {
+            printf("<%u %u %u:%u>\n", token.type, token.value, token.line, token.offset);
+        }
+    }
+    return 0;
+}
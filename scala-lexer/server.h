@@ -0,0 +1,90 @@
+//
+// Persistent lexer daemon over a Unix domain socket
+//
+
+#ifndef CC_LABS_SERVER_H
+#define CC_LABS_SERVER_H
+
+#include <cstddef>
+#include <cstdint>
+
+/// "SLXQ" and "SLXR" in little-endian
+#define SERVER_REQUEST_MAGIC    0x51584c53U
+#define SERVER_RESPONSE_MAGIC   0x52584c53U
+
+/// request payload is a path of the file to lex
+#define SERVER_REQUEST_PATH     1U
+/// request payload is the source to lex
+#define SERVER_REQUEST_BUFFER   2U
+
+#define SERVER_STATUS_OK        0U
+#define SERVER_STATUS_ERROR     1U
+
+#define SERVER_DEFAULT_WORKERS      4
+#define SERVER_DEFAULT_CACHE_SIZE   (256U << 20U)
+#define SERVER_DEFAULT_IDLE_TIMEOUT 30
+#define SERVER_DEFAULT_MAX_STRINGS  (1U << 22U)
+
+/**
+ * Request header, followed by length bytes of the path or the source
+ * A connection may carry any count of requests, each one gets its response
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t kind;
+    uint32_t length;
+} server_request_t;
+
+/**
+ * Response header, followed by token_count server_token_t records and string_count strings
+ * Each string is uint32_t id, uint32_t length and length bytes, ids are stable until the intern table
+ * reaches its limit and is cleared
+ */
+typedef struct {
+    uint32_t magic;
+    uint32_t status;
+    uint32_t token_count;
+    uint32_t string_count;
+} server_response_t;
+
+/**
+ * Token record of the response
+ * value is the string id for identifiers, keywords, float and string literals,
+ * int_value, char_value of char literals and unknown symbols or delim otherwise; code is the keyword or oper code
+ */
+typedef struct {
+    uint8_t type;
+    uint8_t reserved;
+    uint16_t code;
+    uint32_t value;
+    uint64_t pos;
+    uint32_t line;
+    uint32_t offset;
+} server_token_t;
+
+/// Daemon settings
+typedef struct {
+    const char *socket_path;
+    /// count of connections served at the same time
+    int worker_count;
+    /// limit of cached responses in bytes
+    size_t cache_size;
+    /// seconds a connection may stay silent before it is closed and its worker is freed
+    int idle_timeout;
+    /// limit of interned strings, the table and the token cache are cleared when it is reached
+    size_t max_strings;
+} server_config_t;
+
+/**
+ * Serves lexing requests until the process is killed
+ * @return non-zero if the socket could not be opened
+ */
+int server_run(const server_config_t *config);
+
+/**
+ * Sends the file path to the daemon and prints the tokens of the response
+ * @return 0 on success
+ */
+int server_client(const char *socket_path, const char *file_path);
+
+#endif //CC_LABS_SERVER_H
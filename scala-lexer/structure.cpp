@@ -0,0 +1,166 @@
+//
+// Structural index of delimiters and declaration outline
+//
+
+#include <algorithm>
+#include <utility>
+#include "files.h"
+#include "structure.h"
+
+/// pending declaration while outlining
+#define PENDING_NONE        0
+#define PENDING_CONTAINER   1
+#define PENDING_MEMBER      2
+
+/// positions only, the delimiters are paired without payloads
+typedef lex_policy_t<true, false, false, false> lex_structure_policy_t;
+
+static inline bool is_opening(uint32_t delim) {
+    return delim == DELIM_BRACE_OPEN || delim == DELIM_PARENTESIS_OPEN || delim == DELIM_BRACKET_OPEN;
+}
+
+static inline bool is_closing(uint32_t delim) {
+    return delim == DELIM_BRACE_CLOSE || delim == DELIM_PARENTESIS_CLOSE || delim == DELIM_BRACKET_CLOSE;
+}
+
+static inline uint32_t opening_of(uint32_t close) {
+    return close == DELIM_BRACE_CLOSE ? DELIM_BRACE_OPEN :
+           (close == DELIM_PARENTESIS_CLOSE ? DELIM_PARENTESIS_OPEN : DELIM_BRACKET_OPEN);
+}
+
+void structure_index_build(const symbol_t *data, size_t size, structure_index_t *index) {
+    index->positions.clear();
+    index->partners.clear();
+    // delimiter codes of the open delimiters with their indices
+    std::vector<std::pair<uint32_t, uint32_t>> open_stack;
+    lex_reset();
+    lex_input_buffer(data, size);
+    while (true) {
+        token_t token = lex_next_policy<lex_structure_policy_t>();
+        if (token.type == TOKEN_EOF) {
+            break;
+        }
+        if (token.type != TOKEN_DELIMITER || (!is_opening(token.delim) && !is_closing(token.delim))) {
+            continue;
+        }
+        auto current = (uint32_t) index->positions.size();
+        index->positions.push_back(token.pos);
+        index->partners.push_back(STRUCTURE_UNMATCHED);
+        if (is_opening(token.delim)) {
+            open_stack.emplace_back(token.delim, current);
+        } else if (!open_stack.empty() && open_stack.back().first == opening_of(token.delim)) {
+            index->partners[current] = open_stack.back().second;
+            index->partners[open_stack.back().second] = current;
+            open_stack.pop_back();
+        }
+    }
+}
+
+int64_t structure_find_partner(const structure_index_t *index, size_t pos) {
+    auto found = std::lower_bound(index->positions.begin(), index->positions.end(), (uint64_t) pos);
+    if (found == index->positions.end() || *found != pos) {
+        return -1;
+    }
+    uint32_t partner = index->partners[found - index->positions.begin()];
+    if (partner == STRUCTURE_UNMATCHED) {
+        return -1;
+    }
+    return (int64_t) index->positions[partner];
+}
+
+/// skips the block opened at token position, returns false if the block has no pair
+static bool skip_block(const structure_index_t *index, const token_t *token) {
+    int64_t partner = structure_find_partner(index, (size_t) token->pos);
+    if (partner < 0) {
+        return false;
+    }
+    lex_seek((size_t) partner + 1);
+    return true;
+}
+
+int structure_outline(const char *path, int max_depth, FILE *out) {
+    mapped_file_t file{};
+    if (!map_file(path, &file)) {
+        return -1;
+    }
+    structure_index_t index;
+    structure_index_build(file.data, file.size, &index);
+
+    lex_reset();
+    lex_set_filter(TOKEN_MASK(TOKEN_KEYWORD) | TOKEN_MASK(TOKEN_IDENTIFIER) | TOKEN_MASK(TOKEN_DELIMITER));
+    lex_set_lazy_payload(1);
+    lex_input_buffer(file.data, file.size);
+
+    int depth = 0;
+    int pending = PENDING_NONE;
+    const char *pending_kind = nullptr;
+    bool expect_name = false;
+    int reported = 0;
+    token_t token;
+    while (true) {
+        token = lex_next();
+        if (token.type == TOKEN_EOF) {
+            break;
+        }
+        if (token.type == TOKEN_KEYWORD) {
+            expect_name = false;
+            switch (token.keyword) {
+                case KEYWORD_CLASS: pending_kind = "class"; pending = PENDING_CONTAINER; break;
+                case KEYWORD_OBJECT: pending_kind = "object"; pending = PENDING_CONTAINER; break;
+                case KEYWORD_TRAIT: pending_kind = "trait"; pending = PENDING_CONTAINER; break;
+                case KEYWORD_DEF: pending_kind = "def"; pending = PENDING_MEMBER; break;
+                case KEYWORD_VAL:
+                case KEYWORD_VAR:
+                case KEYWORD_TYPE:
+                case KEYWORD_IMPORT:
+                case KEYWORD_PACKAGE: pending = PENDING_NONE; continue;
+                default: continue;
+            }
+            expect_name = true;
+            continue;
+        }
+        if (token.type == TOKEN_IDENTIFIER) {
+            if (expect_name) {
+                expect_name = false;
+                if (max_depth == 0 || depth < max_depth) {
+                    fprintf(out, "%*s%s %.*s :%u\n", depth * 2, "", pending_kind,
+                            (int) token.length, token.ident_value, token.line);
+                    ++reported;
+                }
+            }
+            continue;
+        }
+        expect_name = false;
+        switch (token.delim) {
+            case DELIM_BRACE_OPEN: {
+                if (pending == PENDING_CONTAINER && (max_depth == 0 || depth + 1 < max_depth)) {
+                    ++depth;
+                } else if (!skip_block(&index, &token)) {
+                    // unmatched brace, nothing to skip to
+                    ++depth;
+                }
+                pending = PENDING_NONE;
+                break;
+            }
+            case DELIM_BRACE_CLOSE: {
+                depth = std::max(depth - 1, 0);
+                pending = PENDING_NONE;
+                break;
+            }
+            case DELIM_PARENTESIS_OPEN:
+            case DELIM_BRACKET_OPEN: {
+                // parameters and type parameters do not contain declarations of interest
+                skip_block(&index, &token);
+                break;
+            }
+            default: {
+                // newlines keep the pending declaration, its extends clause or body may follow on the next line
+                break;
+            }
+        }
+    }
+    lex_set_lazy_payload(0);
+    lex_set_filter(TOKEN_MASK_ALL);
+    unmap_file(&file);
+    return reported;
+}
@@ -0,0 +1,51 @@
+//
+// Structural index of delimiters and declaration outline
+//
+
+#ifndef CC_LABS_STRUCTURE_H
+#define CC_LABS_STRUCTURE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include "lexer.h"
+
+/// partner of a delimiter which has no pair
+#define STRUCTURE_UNMATCHED 0xffffffffU
+
+/**
+ * Positions of all {}, () and [] delimiters outside of comments, strings, char literals and back-quoted identifiers
+ * partners[i] is the index of the delimiter paired with positions[i]
+ */
+typedef struct {
+    std::vector<uint64_t> positions;
+    std::vector<uint32_t> partners;
+} structure_index_t;
+
+/**
+ * Builds the index from the delimiter tokens of the lexer, so comments and literals are skipped exactly as in lexing
+ * The input of the lexer is replaced by the data
+ * @param data Input symbols
+ * @param size Count of input symbols
+ * @param index Index to fill
+ */
+void structure_index_build(const symbol_t *data, size_t size, structure_index_t *index);
+
+/**
+ * Finds the delimiter paired with the delimiter at given position
+ * @return position of the paired delimiter, -1 if there is no delimiter at pos or it is unmatched
+ */
+int64_t structure_find_partner(const structure_index_t *index, size_t pos);
+
+/**
+ * Prints class, object, trait and def declarations of the file with their lines, indented by nesting
+ * Bodies of defs and other blocks are skipped with the structural index, they are never lexed
+ * @param path File to outline
+ * @param max_depth Maximal nesting of reported declarations, 0 for unlimited
+ * @param out Output stream
+ * @return count of reported declarations, -1 if the file can not be read
+ */
+int structure_outline(const char *path, int max_depth, FILE *out);
+
+#endif //CC_LABS_STRUCTURE_H
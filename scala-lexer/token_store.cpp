@@ -0,0 +1,210 @@
+//
+// Compressed in-memory token store with random access
+//
+
+#include <algorithm>
+#include <cstring>
+#include "token_store.h"
+
+#define TYPE_LINE_START     0x80U
+#define TYPE_DELIMITER      0x40U
+#define TYPE_VALUE_MASK     0x3fU
+
+static inline void put_varint(std::vector<uint8_t> &out, uint64_t value) {
+    while (value >= 0x80U) {
+        out.push_back((uint8_t) (value | 0x80U));
+        value >>= 7U;
+    }
+    out.push_back((uint8_t) value);
+}
+
+/// data of the store is trusted, so there are no bounds checks
+static inline uint64_t get_varint(const uint8_t *data, size_t *index) {
+    uint64_t result = 0;
+    uint32_t shift = 0;
+    uint8_t byte;
+    do {
+        byte = data[(*index)++];
+        result |= (uint64_t) (byte & 0x7FU) << shift;
+        shift += 7;
+    } while (byte & 0x80U);
+    return result;
+}
+
+static inline uint64_t zigzag(int64_t value) {
+    return ((uint64_t) value << 1U) ^ (uint64_t) (value >> 63);
+}
+
+static inline int64_t unzigzag(uint64_t value) {
+    return (int64_t) (value >> 1U) ^ -(int64_t) (value & 1U);
+}
+
+static inline bool has_string_payload(uint8_t type) {
+    return type == TOKEN_IDENTIFIER || type == TOKEN_KEYWORD || type == TOKEN_FLOAT_LITERAL ||
+           type == TOKEN_STRING_LITERAL || type == TOKEN_WHITESPACE || type == TOKEN_COMMENT;
+}
+
+static uint32_t intern_payload(token_store_t *store, const token_t *token) {
+    const char *payload = token->type == TOKEN_IDENTIFIER || token->type == TOKEN_KEYWORD ?
+                          token->ident_value : token->string_value;
+    std::string value = payload == nullptr ? std::string() : std::string(payload, token->length);
+    auto inserted = store->ids.emplace(std::move(value), (uint32_t) store->strings.size());
+    if (inserted.second) {
+        const std::string &chars = inserted.first->first;
+        uint32_t code = token->type == TOKEN_KEYWORD ? token->keyword :
+                        (token->type == TOKEN_IDENTIFIER ? token->oper : 0);
+        store->strings.push_back({store->chars.size(), (uint32_t) chars.size(), code});
+        store->chars.insert(store->chars.end(), chars.begin(), chars.end());
+        store->chars.push_back('\0');
+    }
+    return inserted.first->second;
+}
+
+void token_store_begin_file(token_store_t *store) {
+    store->files.push_back(store->types.size());
+    store->pos = 0;
+    store->line_start = 0;
+    // the first token always starts a line
+    store->line = 0;
+}
+
+void token_store_append(token_store_t *store, const token_t *token) {
+    if (token->type == TOKEN_EOF) {
+        return;
+    }
+    if (store->files.empty()) {
+        token_store_begin_file(store);
+    }
+    if (store->types.size() % TOKEN_STORE_BLOCK_SIZE == 0) {
+        store->blocks.push_back({store->pos, store->line_start, store->line, store->data.size()});
+    }
+    uint64_t pos = token->pos;
+    uint32_t line = token->line;
+    uint8_t type = token->type == TOKEN_DELIMITER ? (uint8_t) (TYPE_DELIMITER | token->delim) : token->type;
+    put_varint(store->data, zigzag((int64_t) (pos - store->pos)));
+    store->pos = pos;
+    if (line != store->line) {
+        type |= TYPE_LINE_START;
+        put_varint(store->data, zigzag((int64_t) line - (int64_t) store->line));
+        put_varint(store->data, (uint64_t) token->offset);
+        store->line = line;
+        store->line_start = pos - (uint64_t) (token->offset - 1);
+    }
+    store->types.push_back(type);
+    if (has_string_payload(token->type)) {
+        put_varint(store->data, intern_payload(store, token));
+    } else if (token->type == TOKEN_BOOL_LITERAL) {
+        put_varint(store->data, (uint64_t) token->bool_value);
+    } else if (token->type == TOKEN_INT_LITERAL) {
+        put_varint(store->data, token->int_value);
+    } else if (token->type == TOKEN_CHAR_LITERAL || token->type == TOKEN_UNKNOWN) {
+        put_varint(store->data, token->char_value);
+    }
+}
+
+void token_store_seal(token_store_t *store) {
+    std::unordered_map<std::string, uint32_t>().swap(store->ids);
+    store->types.shrink_to_fit();
+    store->data.shrink_to_fit();
+    store->blocks.shrink_to_fit();
+    store->strings.shrink_to_fit();
+    store->chars.shrink_to_fit();
+    store->files.shrink_to_fit();
+}
+
+size_t token_store_size(const token_store_t *store) {
+    return store->types.size();
+}
+
+size_t token_store_memory(const token_store_t *store) {
+    size_t memory = store->types.capacity() + store->data.capacity() + store->chars.capacity() +
+                    store->blocks.capacity() * sizeof(token_store_block_t) +
+                    store->strings.capacity() * sizeof(token_store_string_t) +
+                    store->files.capacity() * sizeof(size_t);
+    for (auto &entry : store->ids) {
+        memory += sizeof(entry) + entry.first.capacity();
+    }
+    return memory;
+}
+
+token_store_cursor_t token_store_seek(const token_store_t *store, size_t index) {
+    token_store_cursor_t cursor{store, 0, 0, 0, 0, 0, store->files.size()};
+    if (index >= store->types.size()) {
+        cursor.index = store->types.size();
+        return cursor;
+    }
+    const token_store_block_t &block = store->blocks[index / TOKEN_STORE_BLOCK_SIZE];
+    cursor.index = index - index % TOKEN_STORE_BLOCK_SIZE;
+    cursor.data_index = block.data_index;
+    cursor.pos = block.pos;
+    cursor.line_start = block.line_start;
+    cursor.line = block.line;
+    cursor.file = (size_t) (std::lower_bound(store->files.begin(), store->files.end(), cursor.index) -
+                            store->files.begin());
+    token_t skipped;
+    while (cursor.index < index) {
+        token_store_next(&cursor, &skipped);
+    }
+    return cursor;
+}
+
+bool token_store_next(token_store_cursor_t *cursor, token_t *token) {
+    const token_store_t *store = cursor->store;
+    if (cursor->index >= store->types.size()) {
+        return false;
+    }
+    if (cursor->file < store->files.size() && store->files[cursor->file] == cursor->index) {
+        // the encoder restarts at every file, empty files share the index with the next one
+        cursor->pos = 0;
+        cursor->line_start = 0;
+        cursor->line = 0;
+        while (cursor->file < store->files.size() && store->files[cursor->file] == cursor->index) {
+            ++cursor->file;
+        }
+    }
+    uint8_t type = store->types[cursor->index++];
+    const uint8_t *data = store->data.data();
+    cursor->pos += (uint64_t) unzigzag(get_varint(data, &cursor->data_index));
+    if (type & TYPE_LINE_START) {
+        cursor->line = (uint32_t) ((int64_t) cursor->line + unzigzag(get_varint(data, &cursor->data_index)));
+        uint64_t offset = get_varint(data, &cursor->data_index);
+        cursor->line_start = cursor->pos - (offset - 1);
+    }
+    memset(token, 0, sizeof(token_t));
+    uint64_t offset = cursor->pos - cursor->line_start + 1;
+    token->pos = cursor->pos;
+    token->line = cursor->line;
+    token->offset = offset > UINT32_MAX ? UINT32_MAX : (uint32_t) offset;
+    if (type & TYPE_DELIMITER) {
+        token->type = TOKEN_DELIMITER;
+        token->delim = type & TYPE_VALUE_MASK;
+        return true;
+    }
+    token->type = type & TYPE_VALUE_MASK;
+    uint64_t value = has_string_payload(token->type) || token->type == TOKEN_BOOL_LITERAL ||
+                     token->type == TOKEN_INT_LITERAL || token->type == TOKEN_CHAR_LITERAL ||
+                     token->type == TOKEN_UNKNOWN ?
+                     get_varint(data, &cursor->data_index) : 0;
+    if (has_string_payload(token->type)) {
+        const token_store_string_t &string = store->strings[value];
+        auto chars = (char *) &store->chars[string.chars_index];
+        token->length = string.length;
+        if (token->type == TOKEN_IDENTIFIER || token->type == TOKEN_KEYWORD) {
+            token->ident_value = chars;
+            token->keyword = string.code;
+        } else {
+            token->string_value = chars;
+        }
+    } else if (token->type == TOKEN_BOOL_LITERAL) {
+        token->bool_value = (bool_t) value;
+    } else if (token->type == TOKEN_INT_LITERAL || token->type == TOKEN_CHAR_LITERAL ||
+               token->type == TOKEN_UNKNOWN) {
+        token->int_value = (uint32_t) value;
+    }
+    return true;
+}
+
+size_t token_store_file_of(const token_store_t *store, size_t index) {
+    auto found = std::upper_bound(store->files.begin(), store->files.end(), index);
+    return found == store->files.begin() ? 0 : (size_t) (found - store->files.begin()) - 1;
+}
@@ -0,0 +1,103 @@
+//
+// Compressed in-memory token store with random access
+//
+
+#ifndef CC_LABS_TOKEN_STORE_H
+#define CC_LABS_TOKEN_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "lexer.h"
+
+/// count of tokens between checkpoints
+#define TOKEN_STORE_BLOCK_SIZE  64U
+
+/// state of the decoder before the first token of a block
+typedef struct {
+    uint64_t pos;
+    uint64_t line_start;
+    uint32_t line;
+    uint64_t data_index;
+} token_store_block_t;
+
+/// interned payload, chars are null-terminated
+typedef struct {
+    uint64_t chars_index;
+    uint32_t length;
+    /// keyword or operator code of identifiers and keywords
+    uint32_t code;
+} token_store_string_t;
+
+/**
+ * Token sequence of one or more files, about 3-4 bytes per token
+ * types holds one byte per token: bit 7 marks the first token of a line, bit 6 marks a delimiter
+ * with its code in the low bits, otherwise low bits are the token type
+ * data holds varints per token: zigzag delta of pos; zigzag delta of line and offset for the first
+ * token of a line; payload string id, literal value or nothing for delimiters
+ */
+typedef struct {
+    std::vector<uint8_t> types;
+    std::vector<uint8_t> data;
+    std::vector<token_store_block_t> blocks;
+    std::vector<token_store_string_t> strings;
+    std::vector<char> chars;
+    /// index of the first token of every file
+    std::vector<size_t> files;
+    /// intern table used while appending, dropped by token_store_seal()
+    std::unordered_map<std::string, uint32_t> ids;
+    /// encoder state after the last token
+    uint64_t pos;
+    uint64_t line_start;
+    uint32_t line;
+} token_store_t;
+
+/// Decoding position in the store
+typedef struct {
+    const token_store_t *store;
+    size_t index;
+    size_t data_index;
+    uint64_t pos;
+    uint64_t line_start;
+    uint32_t line;
+    /// entry of files for the next file start, where the decoder state is reset
+    size_t file;
+} token_store_cursor_t;
+
+/// Starts the next file, positions of its tokens begin from 0
+void token_store_begin_file(token_store_t *store);
+
+/**
+ * Appends the token to the current file, the payload is copied to the side table
+ * EOF tokens are not stored
+ */
+void token_store_append(token_store_t *store, const token_t *token);
+
+/// Frees the intern table, no tokens can be appended after that
+void token_store_seal(token_store_t *store);
+
+/// @return count of stored tokens
+size_t token_store_size(const token_store_t *store);
+
+/// @return bytes used by the store
+size_t token_store_memory(const token_store_t *store);
+
+/**
+ * Positions the cursor before the token with given index
+ * Decoding starts from the nearest checkpoint, so at most TOKEN_STORE_BLOCK_SIZE - 1 tokens are skipped
+ */
+token_store_cursor_t token_store_seek(const token_store_t *store, size_t index);
+
+/**
+ * Decodes the token under the cursor and moves the cursor to the next one
+ * Payloads of the token point into the store and are valid while the store is alive
+ * @return false, if there are no more tokens
+ */
+bool token_store_next(token_store_cursor_t *cursor, token_t *token);
+
+/// @return index of the file which contains the token
+size_t token_store_file_of(const token_store_t *store, size_t index);
+
+#endif //CC_LABS_TOKEN_STORE_H
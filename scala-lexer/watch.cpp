@@ -0,0 +1,268 @@
+//
+// Watch mode keeping token summaries of a source tree up to date
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <iterator>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "files.h"
+#include "lexer.h"
+#include "watch.h"
+
+#define WATCH_DIR_EVENTS (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF)
+
+/// inotify descriptor with the directory of each watch
+typedef struct {
+    int fd;
+    std::unordered_map<int, std::string> dirs;
+} watch_tree_t;
+
+static uint32_t intern_identifier(watch_state_t *state, const char *value, size_t length) {
+    auto inserted = state->ids.emplace(std::string(value, length), (uint32_t) state->names.size());
+    if (inserted.second) {
+        state->names.push_back(inserted.first->first);
+    }
+    return inserted.first->second;
+}
+
+bool watch_update_file(watch_state_t *state, const std::string &path) {
+    mapped_file_t file{};
+    if (!map_file(path.c_str(), &file)) {
+        state->files.erase(path);
+        return false;
+    }
+    uint64_t hash = hash_content(file.data, file.size);
+    auto found = state->files.find(path);
+    if (found != state->files.end() && found->second.hash == hash) {
+        ++state->unchanged;
+        unmap_file(&file);
+        return false;
+    }
+    watch_summary_t summary{hash, 0, {}};
+    lex_reset();
+    lex_set_lazy_payload(1);
+    lex_input_buffer(file.data, file.size);
+    token_t token;
+    while (true) {
+        token = lex_next();
+        if (token.type == TOKEN_EOF) {
+            break;
+        }
+        ++summary.token_count;
+        if (token.type == TOKEN_IDENTIFIER) {
+            summary.identifiers.push_back(intern_identifier(state, token.ident_value, token.length));
+        }
+    }
+    lex_set_lazy_payload(0);
+    unmap_file(&file);
+    std::sort(summary.identifiers.begin(), summary.identifiers.end());
+    summary.identifiers.erase(std::unique(summary.identifiers.begin(), summary.identifiers.end()),
+                              summary.identifiers.end());
+    state->files[path] = std::move(summary);
+    ++state->lexed;
+    return true;
+}
+
+/// removes summaries of the file or of all files under the directory
+static void remove_path(watch_state_t *state, const std::string &path) {
+    state->files.erase(path);
+    std::string prefix = path + "/";
+    for (auto it = state->files.begin(); it != state->files.end();) {
+        if (it->first.compare(0, prefix.size(), prefix) == 0) {
+            it = state->files.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+/// watches the directory and its subdirectories, lexing the sources found there
+static void add_tree(watch_tree_t *tree, watch_state_t *state, const std::string &dir) {
+    int wd = inotify_add_watch(tree->fd, dir.c_str(), WATCH_DIR_EVENTS | IN_ONLYDIR);
+    if (wd < 0) {
+        fprintf(stderr, "Unable to watch %s: %s\n", dir.c_str(), strerror(errno));
+        return;
+    }
+    tree->dirs[wd] = dir;
+    DIR *handle = opendir(dir.c_str());
+    if (handle == nullptr) {
+        return;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(handle)) != nullptr) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        std::string path = dir + "/" + entry->d_name;
+        struct stat entry_stat{};
+        if (stat(path.c_str(), &entry_stat) != 0) {
+            continue;
+        }
+        if (S_ISDIR(entry_stat.st_mode)) {
+            add_tree(tree, state, path);
+        } else if (S_ISREG(entry_stat.st_mode) && has_scala_extension(entry->d_name)) {
+            watch_update_file(state, path);
+        }
+    }
+    closedir(handle);
+}
+
+static void handle_event(watch_tree_t *tree, watch_state_t *state, const inotify_event *event) {
+    if (event->mask & IN_IGNORED) {
+        tree->dirs.erase(event->wd);
+        return;
+    }
+    auto dir = tree->dirs.find(event->wd);
+    if (dir == tree->dirs.end() || event->len == 0 || event->name[0] == '.') {
+        return;
+    }
+    std::string path = dir->second + "/" + event->name;
+    if (event->mask & IN_ISDIR) {
+        if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+            add_tree(tree, state, path);
+        } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+            // watches of the moved directory still report old paths, so they are dropped
+            std::string prefix = path + "/";
+            for (auto it = tree->dirs.begin(); it != tree->dirs.end(); ++it) {
+                if (it->second == path || it->second.compare(0, prefix.size(), prefix) == 0) {
+                    inotify_rm_watch(tree->fd, it->first);
+                }
+            }
+            remove_path(state, path);
+        }
+        return;
+    }
+    if (!has_scala_extension(event->name)) {
+        return;
+    }
+    if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+        state->files.erase(path);
+    } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE)) {
+        if (watch_update_file(state, path)) {
+            fprintf(stderr, "Lexed %s\n", path.c_str());
+        }
+    }
+}
+
+/**
+ * Answers one query line
+ * @return false, if the watch should stop
+ */
+static bool handle_query(const watch_state_t *state, const std::string &line) {
+    std::string command = line.substr(0, line.find(' '));
+    std::string argument = command.size() < line.size() ? line.substr(command.size() + 1) : std::string();
+    if (command == "quit") {
+        return false;
+    }
+    if (command == "stats") {
+        size_t tokens = 0;
+        for (auto &entry : state->files) {
+            tokens += entry.second.token_count;
+        }
+        printf("files %zu tokens %zu identifiers %zu lexed %zu unchanged %zu\n",
+               state->files.size(), tokens, state->names.size(), state->lexed, state->unchanged);
+    } else if (command == "file") {
+        auto found = state->files.find(argument);
+        if (found == state->files.end()) {
+            printf("not found %s\n", argument.c_str());
+        } else {
+            printf("%s hash %016llx tokens %zu identifiers %zu\n", argument.c_str(),
+                   (unsigned long long) found->second.hash, found->second.token_count,
+                   found->second.identifiers.size());
+        }
+    } else if (command == "ident") {
+        auto id = state->ids.find(argument);
+        std::vector<std::string> paths;
+        for (auto &entry : state->files) {
+            const std::vector<uint32_t> &identifiers = entry.second.identifiers;
+            if (id != state->ids.end() && std::binary_search(identifiers.begin(), identifiers.end(), id->second)) {
+                paths.push_back(entry.first);
+            }
+        }
+        std::sort(paths.begin(), paths.end());
+        for (auto &path : paths) {
+            printf("%s\n", path.c_str());
+        }
+        printf("%zu files\n", paths.size());
+    } else if (!command.empty()) {
+        printf("unknown query %s\n", command.c_str());
+    }
+    fflush(stdout);
+    return true;
+}
+
+int watch_run(const char *root) {
+    watch_tree_t tree{};
+    tree.fd = inotify_init1(IN_CLOEXEC);
+    if (tree.fd < 0) {
+        perror("inotify_init1");
+        return 1;
+    }
+    std::string root_path(root);
+    while (root_path.size() > 1 && root_path.back() == '/') {
+        root_path.pop_back();
+    }
+    watch_state_t state{};
+    add_tree(&tree, &state, root_path);
+    if (tree.dirs.empty()) {
+        close(tree.fd);
+        return 1;
+    }
+    fprintf(stderr, "Watching %zu files in %zu directories\n", state.files.size(), tree.dirs.size());
+
+    alignas(inotify_event) char events[64 * (sizeof(inotify_event) + NAME_MAX + 1)];
+    std::string pending_input;
+    char input[4096];
+    pollfd fds[2] = {{tree.fd, POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+    nfds_t fd_count = 2;
+    bool running = true;
+    while (running && !tree.dirs.empty()) {
+        if (poll(fds, fd_count, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            ssize_t length = read(tree.fd, events, sizeof(events));
+            for (ssize_t i = 0; i < length;) {
+                auto event = (const inotify_event *) (events + i);
+                if (event->mask & IN_Q_OVERFLOW) {
+                    // events are lost, the hashes make the full rescan cheap
+                    fprintf(stderr, "Event queue overflow, rescanning\n");
+                    for (auto it = state.files.begin(); it != state.files.end();) {
+                        it = access(it->first.c_str(), R_OK) == 0 ? std::next(it) : state.files.erase(it);
+                    }
+                    add_tree(&tree, &state, root_path);
+                } else {
+                    handle_event(&tree, &state, event);
+                }
+                i += (ssize_t) sizeof(inotify_event) + event->len;
+            }
+        }
+        if (fd_count > 1 && (fds[1].revents & (POLLIN | POLLHUP))) {
+            ssize_t length = read(STDIN_FILENO, input, sizeof(input));
+            if (length <= 0) {
+                // no more queries, keep watching
+                fd_count = 1;
+                continue;
+            }
+            pending_input.append(input, (size_t) length);
+            size_t newline;
+            while (running && (newline = pending_input.find('\n')) != std::string::npos) {
+                running = handle_query(&state, pending_input.substr(0, newline));
+                pending_input.erase(0, newline + 1);
+            }
+        }
+    }
+    close(tree.fd);
+    return 0;
+}
@@ -0,0 +1,49 @@
+//
+// Watch mode keeping token summaries of a source tree up to date
+//
+
+#ifndef CC_LABS_WATCH_H
+#define CC_LABS_WATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/// Token summary of one source file
+typedef struct {
+    uint64_t hash;
+    size_t token_count;
+    /// sorted ids of distinct identifiers, see watch_state_t::names
+    std::vector<uint32_t> identifiers;
+} watch_summary_t;
+
+/// Summaries of all watched files
+typedef struct {
+    std::unordered_map<std::string, watch_summary_t> files;
+    /// identifier intern table
+    std::unordered_map<std::string, uint32_t> ids;
+    std::vector<std::string> names;
+    /// count of files lexed since start
+    size_t lexed;
+    /// count of change events skipped because the content hash did not change
+    size_t unchanged;
+} watch_state_t;
+
+/**
+ * Lexes the file and replaces its summary, unless the content hash is the same
+ * Summary of the file is removed if the file cannot be read
+ * @return true, if the file was lexed
+ */
+bool watch_update_file(watch_state_t *state, const std::string &path);
+
+/**
+ * Lexes the tree, then re-lexes files reported by inotify as created, modified or renamed
+ * Queries are read from stdin line by line:
+ *   stats, file <path>, ident <identifier>, quit
+ * @return non-zero if the tree cannot be watched
+ */
+int watch_run(const char *root);
+
+#endif //CC_LABS_WATCH_H
@@ -0,0 +1,21 @@
+// Outline regression: literals which hide delimiters from the structural index
+// Expected: scala_lex --outline prints Paths, join, after, Next, m, n, Tail and f, nothing after it
+object Paths {
+  val sep = "\\"
+  def join(a: String) = {
+    a + sep + "{" + "\"}"
+  }
+  val brace = '{'
+  def after = 1
+}
+class Next {
+  def m = "unterminated {
+  def n = 2
+}
+class Tail {
+  def f = 1
+  val text = """multiline literal without its closing quotes {
+}
+class Hidden {
+  def g = 1
+}